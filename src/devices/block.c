@@ -3,7 +3,12 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/iotrace.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* A block device. */
 struct block
@@ -11,19 +16,77 @@ struct block
     struct list_elem list_elem;         /* Element in all_blocks. */
 
     char name[16];                      /* Block device name. */
+    unsigned id;                        /* Number, in order of
+                                           registration. */
     enum block_type type;                /* Type of block device. */
     block_sector_t size;                 /* Size in sectors. */
 
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct block_stats stats;           /* Statistics.  Queue depth is
+                                           updated under QUEUE's lock,
+                                           the rest with interrupts
+                                           off. */
+
+    /* Request queue.  Protected by QUEUE's lock. */
+    struct block_queue *queue;          /* Dispatcher, or null for none. */
+    struct list_elem queue_elem;        /* Element in QUEUE's devices. */
+    struct list requests[BLOCK_IOPRIO_CNT]; /* Queued requests by class,
+                                               each sorted by sector. */
+    block_sector_t head;                /* Sector after the last dispatched. */
+    int pending;                        /* Requests queued or in progress. */
+    struct condition idle;              /* Signaled when PENDING drops to 0. */
+
+    struct block *lower;                /* Device holding our sectors, or null. */
+    block_sector_t lower_start;         /* Our sector 0 within LOWER. */
+  };
+
+/* A dispatcher thread that carries out the queued requests of
+   one or more devices that cannot work in parallel, such as the
+   disks on an IDE channel.
+
+   Each device's queue is kept sorted by sector and served in
+   C-LOOK order: the dispatcher takes the first request at or
+   past the sector where the last one ended, wrapping around to
+   the lowest, so the disk head sweeps in one direction.  Queued
+   requests that continue where the chosen one ends, in the same
+   direction, are merged into a single transfer.
+
+   Each I/O class has a queue of its own, and the dispatcher
+   serves the highest class with requests, unless a request of a
+   lower class has waited longer than ioprio_max_wait[] for its
+   class, in which case that class goes next.  This holds across
+   the devices too: the device whose next request is overdue or
+   of the highest class is served next, and devices that tie are
+   served round-robin. */
+struct block_queue
+  {
+    struct lock lock;                   /* Protects the queues. */
+    struct condition work;              /* Signaled on submission. */
+    struct list devices;                /* Devices served. */
   };
 
+/* How long, in microseconds, a request of each class may wait
+   while higher classes are served.  Realtime requests are never
+   held back for lower classes. */
+static const int64_t ioprio_max_wait[BLOCK_IOPRIO_CNT] =
+  {
+    0,                                  /* Realtime. */
+    100 * 1000,                         /* Best-effort. */
+    500 * 1000,                         /* Idle. */
+  };
+
+/* Limits on a merged transfer. */
+#define MERGE_SECTORS 256               /* Sectors. */
+#define MERGE_IOV 16                    /* Buffer pieces. */
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
+/* Number for the next block device registered. */
+static unsigned next_id;
+
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
@@ -113,6 +176,228 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Returns the number of sectors that the IOV_CNT pieces in IOV
+   add up to. */
+static block_sector_t
+iov_sectors (const struct block_iovec *iov, size_t iov_cnt)
+{
+  block_sector_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    cnt += iov[i].cnt;
+  return cnt;
+}
+
+/* Verifies that the CNT sectors starting at SECTOR are all
+   within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
+{
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    check_sector (block, sector + cnt);
+}
+
+/* Has BLOCK's driver move consecutive sectors, starting at
+   SECTOR, into the IOV_CNT pieces of IOV if WRITE is false or
+   out of them if it is true, in as few commands as it can. */
+static void
+device_io (struct block *block, block_sector_t sector,
+           const struct block_iovec *iov, size_t iov_cnt, bool write)
+{
+  size_t i, j;
+
+  if (write && block->ops->writev != NULL)
+    block->ops->writev (block->aux, sector, iov, iov_cnt);
+  else if (!write && block->ops->readv != NULL)
+    block->ops->readv (block->aux, sector, iov, iov_cnt);
+  else
+    for (i = 0; i < iov_cnt; i++)
+      for (j = 0; j < iov[i].cnt; j++)
+        {
+          uint8_t *buffer = (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE;
+          if (write)
+            block->ops->write (block->aux, sector++, buffer);
+          else
+            block->ops->read (block->aux, sector++, buffer);
+        }
+}
+
+/* Initializes R as a request to read consecutive sectors,
+   starting at SECTOR, into the IOV_CNT pieces of IOV if WRITE is
+   false, or to write them from IOV if WRITE is true.  On
+   completion, DONE is called, from the device's dispatcher
+   thread, with R if it is non-null; otherwise, block_wait() on R
+   returns.  AUX is stored in R for DONE's use.  R's I/O class is
+   the running thread's, which the caller may change before
+   submitting R. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector,
+                    const struct block_iovec *iov, size_t iov_cnt,
+                    block_done_func *done, void *aux)
+{
+  r->write = write;
+  r->prio = thread_current ()->ioprio;
+  r->sector = sector;
+  r->cnt = iov_sectors (iov, iov_cnt);
+  r->iov = iov;
+  r->iov_cnt = iov_cnt;
+  r->done = done;
+  r->aux = aux;
+  sema_init (&r->complete, 0);
+}
+
+/* Sets the running thread's I/O class, which the block requests
+   it submits get, to PRIO.  Returns the previous class. */
+enum block_ioprio
+block_set_ioprio (enum block_ioprio prio)
+{
+  struct thread *t = thread_current ();
+  enum block_ioprio old = t->ioprio;
+
+  ASSERT (prio < BLOCK_IOPRIO_CNT);
+  t->ioprio = prio;
+  return old;
+}
+
+/* Returns the histogram bucket for a latency of US
+   microseconds. */
+static int
+latency_bucket (int64_t us)
+{
+  int bucket = 0;
+
+  while (us > 0 && bucket < BLOCK_LATENCY_BUCKETS - 1)
+    {
+      us >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* Reports that R has completed. */
+static void
+complete (struct block_request *r)
+{
+  struct block_stats *stats = &r->origin->stats;
+  int64_t now = timer_usecs ();
+  int bucket = latency_bucket (now - r->submit_us);
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  stats->requests++;
+  stats->wait_us += r->start_us - r->submit_us;
+  stats->class_requests[r->prio]++;
+  stats->class_wait_us[r->prio] += r->start_us - r->submit_us;
+  stats->device_us += now - r->start_us;
+  if (r->write)
+    stats->write_latency[bucket]++;
+  else
+    stats->read_latency[bucket]++;
+  intr_set_level (old_level);
+
+  if (r->done != NULL)
+    r->done (r);
+  else
+    sema_up (&r->complete);
+}
+
+/* Orders requests by first sector. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+  return a->sector < b->sector;
+}
+
+/* Submits R, which must have been initialized with
+   block_request_init(), to BLOCK.  If BLOCK has a dispatcher,
+   queues R for it and returns at once; otherwise, carries out R
+   before returning. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  struct block_queue *q;
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (r->cnt > 0);
+  for (i = 0; i < r->iov_cnt; i++)
+    ASSERT (is_kernel_vaddr (r->iov[i].buffer));
+  check_sectors (block, r->sector, r->cnt);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+
+  r->origin = block;
+  r->submit_us = r->start_us = timer_usecs ();
+  iotrace_record (r->write ? IOTRACE_BLOCK_WRITE : IOTRACE_BLOCK_READ,
+                  block->id, r->sector, r->cnt, 0);
+
+  /* Pass the request down to the device whose sectors BLOCK's
+     are, counting it at each level. */
+  for (;;)
+    {
+      old_level = intr_disable ();
+      if (r->write)
+        block->stats.write_cnt += r->cnt;
+      else
+        block->stats.read_cnt += r->cnt;
+      intr_set_level (old_level);
+      if (block->queue != NULL || block->lower == NULL)
+        break;
+      r->sector += block->lower_start;
+      block = block->lower;
+    }
+
+  q = block->queue;
+  if (q == NULL)
+    {
+      device_io (block, r->sector, r->iov, r->iov_cnt, r->write);
+      complete (r);
+      return;
+    }
+
+  lock_acquire (&q->lock);
+  ASSERT (r->prio < BLOCK_IOPRIO_CNT);
+  list_insert_ordered (&block->requests[r->prio], &r->elem, request_less,
+                       NULL);
+  block->pending++;
+  block->stats.queued++;
+  block->stats.depth_sum += block->pending;
+  if (block->pending > block->stats.max_depth)
+    block->stats.max_depth = block->pending;
+  cond_signal (&q->work, &q->lock);
+  lock_release (&q->lock);
+}
+
+/* Waits for R, which must have been submitted without a
+   completion function, to complete. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->done == NULL);
+  sema_down (&r->complete);
+}
+
+/* Reads or writes, according to WRITE, the IOV_CNT pieces of IOV
+   starting at SECTOR of BLOCK, and waits for completion. */
+static void
+block_rw (struct block *block, block_sector_t sector,
+          const struct block_iovec *iov, size_t iov_cnt, bool write)
+{
+  struct block_request r;
+
+  block_request_init (&r, write, sector, iov, iov_cnt, NULL, NULL);
+  if (r.cnt == 0)
+    return;
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +405,52 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  struct block_iovec iov = { buffer, 1 };
+  block_rw (block, sector, &iov, 1, false);
+}
+
+/* Reads consecutive sectors from BLOCK, starting at SECTOR, into
+   the IOV_CNT pieces of IOV in order.  Devices that can move
+   several sectors with one command do so.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_readv (struct block *block, block_sector_t sector,
+             const struct block_iovec *iov, size_t iov_cnt)
+{
+  block_rw (block, sector, iov, iov_cnt, false);
+}
+
+/* Writes consecutive sectors to BLOCK, starting at SECTOR, from
+   the IOV_CNT pieces of IOV in order.  Returns after the block
+   device has acknowledged receiving all of the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_writev (struct block *block, block_sector_t sector,
+              const struct block_iovec *iov, size_t iov_cnt)
+{
+  block_rw (block, sector, iov, iov_cnt, true);
+}
+
+/* Reads CNT consecutive sectors from BLOCK, starting at SECTOR,
+   into BUFFER, which must have room for them all. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     block_sector_t cnt, void *buffer)
+{
+  struct block_iovec iov = { buffer, cnt };
+  block_rw (block, sector, &iov, 1, false);
+}
+
+/* Writes CNT consecutive sectors to BLOCK, starting at SECTOR,
+   from BUFFER. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      block_sector_t cnt, const void *buffer)
+{
+  struct block_iovec iov = { (void *) buffer, cnt };
+  block_rw (block, sector, &iov, 1, true);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +461,30 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  struct block_iovec iov = { (void *) buffer, 1 };
+  block_rw (block, sector, &iov, 1, true);
+}
+
+/* Returns once every sector written to BLOCK so far has reached
+   the underlying media, including those of requests still
+   queued.  Devices that acknowledge writes only after completing
+   them need not provide a flush operation. */
+void
+block_flush (struct block *block)
+{
+  struct block *b;
+
+  for (b = block; b != NULL; b = b->lower)
+    if (b->queue != NULL)
+      {
+        lock_acquire (&b->queue->lock);
+        while (b->pending > 0)
+          cond_wait (&b->idle, &b->queue->lock);
+        lock_release (&b->queue->lock);
+        break;
+      }
+  if (block->ops->flush != NULL)
+    block->ops->flush (block->aux);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,6 +508,85 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Prints the histogram of latencies in HISTOGRAM, labeled
+   NAME, for BLOCK, skipping empty buckets. */
+static void
+print_latency (struct block *block, const char *name,
+               const unsigned long long histogram[BLOCK_LATENCY_BUCKETS])
+{
+  int i;
+
+  printf ("%s: %s latency (us):", block->name, name);
+  for (i = 0; i < BLOCK_LATENCY_BUCKETS; i++)
+    if (histogram[i] != 0)
+      {
+        if (i < BLOCK_LATENCY_BUCKETS - 1)
+          printf (" <%lu:%llu", 1ul << i, histogram[i]);
+        else
+          printf (" more:%llu", histogram[i]);
+      }
+  printf ("\n");
+}
+
+/* Prints how long BLOCK's requests of each I/O class waited in
+   the queue, from STATS, as total microseconds over number of
+   requests, skipping classes without requests. */
+static void
+print_class_waits (struct block *block, const struct block_stats *stats)
+{
+  static const char *class_names[BLOCK_IOPRIO_CNT] =
+    {"realtime", "best-effort", "idle"};
+  int c;
+
+  printf ("%s: queue wait by class (us):", block->name);
+  for (c = 0; c < BLOCK_IOPRIO_CNT; c++)
+    if (stats->class_requests[c] != 0)
+      printf (" %s %"PRId64"/%llu", class_names[c],
+              stats->class_wait_us[c], stats->class_requests[c]);
+  printf ("\n");
+}
+
+/* Prints BLOCK's timing statistics, and those of the device
+   whose queue serves it. */
+static void
+print_device_stats (struct block *block)
+{
+  struct block_stats s;
+  struct block *b;
+
+  block_get_stats (block, &s);
+  printf ("%s: %llu bytes read, %llu bytes written in %llu requests, "
+          "%"PRId64" us queued, %"PRId64" us on device\n",
+          block->name, s.read_cnt * BLOCK_SECTOR_SIZE,
+          s.write_cnt * BLOCK_SECTOR_SIZE, s.requests,
+          s.wait_us, s.device_us);
+  print_latency (block, "read", s.read_latency);
+  print_latency (block, "write", s.write_latency);
+  print_class_waits (block, &s);
+
+  for (b = block; b != NULL && b->queue == NULL; b = b->lower)
+    continue;
+  if (b != NULL)
+    {
+      block_get_stats (b, &s);
+      if (s.queued > 0)
+        printf ("%s: queue depth %d max, %llu.%02llu average\n",
+                b->name, s.max_depth, s.depth_sum / s.queued,
+                s.depth_sum * 100 / s.queued % 100);
+    }
+}
+
+/* Stores a snapshot of BLOCK's statistics into *STATS.  Takes no
+   locks, so that it works even while panicking. */
+void
+block_get_stats (struct block *block, struct block_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = block->stats;
+  stats->depth = block->pending;
+  intr_set_level (old_level);
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -173,7 +600,8 @@ block_print_stats (void)
         {
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->stats.read_cnt, block->stats.write_cnt);
+          print_device_stats (block);
         }
     }
 }
@@ -189,17 +617,27 @@ block_register (const char *name, enum block_type type,
                 const struct block_operations *ops, void *aux)
 {
   struct block *block = malloc (sizeof *block);
+  int i;
+
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
   list_push_back (&all_blocks, &block->list_elem);
   strlcpy (block->name, name, sizeof block->name);
+  block->id = next_id++;
   block->type = type;
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->queue = NULL;
+  for (i = 0; i < BLOCK_IOPRIO_CNT; i++)
+    list_init (&block->requests[i]);
+  block->head = 0;
+  block->pending = 0;
+  cond_init (&block->idle);
+  block->lower = NULL;
+  block->lower_start = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -211,6 +649,252 @@ block_register (const char *name, enum block_type type,
   return block;
 }
 
+/* Returns true if a request in REQUESTS, BLOCK's queue for class
+   C, had waited longer than ioprio_max_wait[C] at time NOW. */
+static bool
+class_overdue (struct list *requests, int c, int64_t now)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (requests); e != list_end (requests);
+       e = list_next (e))
+    if (now - list_entry (e, struct block_request, elem)->submit_us
+        > ioprio_max_wait[c])
+      return true;
+  return false;
+}
+
+/* Returns the queue of BLOCK's requests that should be served
+   next, or a null pointer if none are queued.  If OVERDUE is
+   nonnull, sets *OVERDUE to whether that queue's class has a
+   request that has waited too long.  Must be called with BLOCK's
+   queue lock held. */
+static struct list *
+next_class (struct block *block, bool *overdue)
+{
+  struct list *first = NULL;
+  int64_t now = 0;
+  int c;
+
+  for (c = 0; c < BLOCK_IOPRIO_CNT; c++)
+    {
+      struct list *requests = &block->requests[c];
+
+      if (list_empty (requests))
+        continue;
+      if (first == NULL)
+        {
+          first = requests;
+          now = timer_usecs ();
+          if (overdue != NULL)
+            *overdue = c > 0 && class_overdue (requests, c, now);
+          continue;
+        }
+
+      /* A request that has waited too long behind higher classes
+         takes its class to the front. */
+      if (class_overdue (requests, c, now))
+        {
+          if (overdue != NULL)
+            *overdue = true;
+          return requests;
+        }
+    }
+  return first;
+}
+
+/* Returns the device in Q whose requests should be served next,
+   or a null pointer if none has requests queued.  Like the
+   classes within one device, a device with an overdue request
+   goes first, then the one whose next request is of the highest
+   class.  Devices that tie are served round-robin.  Must be
+   called with Q's lock held. */
+static struct block *
+next_busy_device (struct block_queue *q)
+{
+  struct list_elem *e, *best = NULL;
+  int best_rank = 0;
+
+  for (e = list_begin (&q->devices); e != list_end (&q->devices);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, queue_elem);
+      bool overdue;
+      struct list *requests = next_class (block, &overdue);
+      int rank;
+
+      if (requests == NULL)
+        continue;
+      rank = (requests - block->requests) + (overdue ? 0 : BLOCK_IOPRIO_CNT);
+      if (best == NULL || rank < best_rank)
+        {
+          best = e;
+          best_rank = rank;
+        }
+    }
+  if (best == NULL)
+    return NULL;
+
+  /* Let the others of its rank go first next time. */
+  list_remove (best);
+  list_push_back (&q->devices, best);
+  return list_entry (best, struct block, queue_elem);
+}
+
+/* Moves the next requests to carry out from BLOCK's queue into
+   BATCH: from the class next_class() picks, in C-LOOK order,
+   merging those that continue where the first one ends.  Must be
+   called with BLOCK's queue lock held, and some request must be
+   queued. */
+static void
+take_batch (struct block *block, struct list *batch)
+{
+  struct list *requests = next_class (block, NULL);
+  struct block_request *first;
+  struct list_elem *e;
+  block_sector_t end;
+  size_t iov_cnt;
+
+  for (e = list_begin (requests); e != list_end (requests);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector >= block->head)
+      break;
+  if (e == list_end (requests))
+    e = list_begin (requests);
+
+  first = list_entry (e, struct block_request, elem);
+  end = first->sector + first->cnt;
+  iov_cnt = first->iov_cnt;
+  e = list_remove (e);
+  list_push_back (batch, &first->elem);
+
+  while (e != list_end (requests))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector != end || r->write != first->write
+          || end - first->sector + r->cnt > MERGE_SECTORS
+          || iov_cnt + r->iov_cnt > MERGE_IOV)
+        break;
+      end += r->cnt;
+      iov_cnt += r->iov_cnt;
+      e = list_remove (e);
+      list_push_back (batch, &r->elem);
+    }
+  block->head = end;
+}
+
+/* Carries out the consecutive requests in BATCH on BLOCK as one
+   transfer and completes them.  Returns the number of requests. */
+static int
+run_batch (struct block *block, struct list *batch)
+{
+  struct block_request *first
+    = list_entry (list_front (batch), struct block_request, elem);
+  int64_t now = timer_usecs ();
+  struct list_elem *e;
+  int cnt = 0;
+
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    list_entry (e, struct block_request, elem)->start_us = now;
+
+  if (list_size (batch) == 1)
+    device_io (block, first->sector, first->iov, first->iov_cnt,
+               first->write);
+  else
+    {
+      struct block_iovec iov[MERGE_IOV];
+      size_t iov_cnt = 0;
+
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request,
+                                                elem);
+          memcpy (iov + iov_cnt, r->iov, r->iov_cnt * sizeof *iov);
+          iov_cnt += r->iov_cnt;
+        }
+      device_io (block, first->sector, iov, iov_cnt, first->write);
+    }
+
+  while (!list_empty (batch))
+    {
+      complete (list_entry (list_pop_front (batch),
+                            struct block_request, elem));
+      cnt++;
+    }
+  return cnt;
+}
+
+/* Dispatcher thread for block queue Q_. */
+static void
+dispatch (void *q_)
+{
+  struct block_queue *q = q_;
+
+  for (;;)
+    {
+      struct block *block;
+      struct list batch;
+      int cnt;
+
+      list_init (&batch);
+      lock_acquire (&q->lock);
+      while ((block = next_busy_device (q)) == NULL)
+        cond_wait (&q->work, &q->lock);
+      take_batch (block, &batch);
+      lock_release (&q->lock);
+
+      cnt = run_batch (block, &batch);
+
+      lock_acquire (&q->lock);
+      block->pending -= cnt;
+      if (block->pending == 0)
+        cond_broadcast (&block->idle, &q->lock);
+      lock_release (&q->lock);
+    }
+}
+
+/* Creates a request queue and starts a dispatcher thread named
+   NAME to serve it.  Devices are added to it with
+   block_set_queue(). */
+struct block_queue *
+block_queue_create (const char *name)
+{
+  struct block_queue *q = malloc (sizeof *q);
+  if (q == NULL)
+    PANIC ("Failed to allocate memory for block queue");
+
+  lock_init (&q->lock);
+  cond_init (&q->work);
+  list_init (&q->devices);
+  if (thread_create (name, PRI_DEFAULT, dispatch, q) == TID_ERROR)
+    PANIC ("Failed to start block queue dispatcher %s", name);
+  return q;
+}
+
+/* Makes Q's dispatcher carry out BLOCK's requests.  Must be
+   called before any request is submitted to BLOCK. */
+void
+block_set_queue (struct block *block, struct block_queue *q)
+{
+  ASSERT (block->queue == NULL);
+
+  lock_acquire (&q->lock);
+  block->queue = q;
+  list_push_back (&q->devices, &block->queue_elem);
+  lock_release (&q->lock);
+}
+
+/* Declares that UPPER's sectors are those of LOWER starting at
+   START, as for a partition, so that requests submitted to UPPER
+   go straight to LOWER's queue. */
+void
+block_stack (struct block *upper, struct block *lower, block_sector_t start)
+{
+  ASSERT (upper->queue == NULL);
+  upper->lower = lower;
+  upper->lower_start = start;
+}
+
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
 static struct block *
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -49,14 +51,115 @@ struct block *block_get_by_name (const char *name);
 struct block *block_first (void);
 struct block *block_next (struct block *);
 
+/* One piece of a scatter/gather transfer: CNT consecutive
+   sectors' worth of bytes at BUFFER.
+
+   Data buffers passed to any of the block_*() transfer functions
+   must be kernel virtual addresses: devices may move them by DMA
+   or from a dispatcher thread that has no user address space.
+   Copy user data through a kernel buffer first. */
+struct block_iovec
+  {
+    void *buffer;
+    block_sector_t cnt;
+  };
+
 /* Block device operations. */
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_readv (struct block *, block_sector_t,
+                  const struct block_iovec *, size_t iov_cnt);
+void block_writev (struct block *, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
+void block_read_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                           const void *);
+void block_flush (struct block *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests. */
+
+/* I/O classes.  A device's dispatcher serves queued requests of
+   a higher class first, except that one that has waited too long
+   behind higher classes goes next. */
+enum block_ioprio
+  {
+    BLOCK_IOPRIO_RT,            /* Realtime: program loads, metadata. */
+    BLOCK_IOPRIO_BE,            /* Best-effort: ordinary I/O. */
+    BLOCK_IOPRIO_IDLE,          /* Idle: background work. */
+    BLOCK_IOPRIO_CNT
+  };
+
+enum block_ioprio block_set_ioprio (enum block_ioprio);
+
+struct block_request;
+typedef void block_done_func (struct block_request *);
+
+/* A request to read or write consecutive sectors, which may
+   complete after block_submit() returns.  The block layer owns
+   the request, and IOV with it, from submission until
+   completion.  Requests that overlap are not ordered with
+   respect to each other, so a caller must wait for one to
+   complete before submitting the other. */
+struct block_request
+  {
+    struct list_elem elem;              /* Element in a device queue. */
+    bool write;                         /* Write, as opposed to read? */
+    enum block_ioprio prio;             /* I/O class. */
+    block_sector_t sector;              /* First sector. */
+    block_sector_t cnt;                 /* Number of sectors. */
+    const struct block_iovec *iov;      /* Data to write or room to read. */
+    size_t iov_cnt;                     /* Number of pieces in IOV. */
+    block_done_func *done;              /* Called on completion, or null. */
+    void *aux;                          /* For DONE's use. */
+    struct semaphore complete;          /* Up'd on completion if no DONE. */
+
+    /* Set by the block layer. */
+    struct block *origin;               /* Device submitted to. */
+    int64_t submit_us;                  /* timer_usecs() at submission. */
+    int64_t start_us;                   /* timer_usecs() when started. */
+  };
+
+void block_request_init (struct block_request *, bool write, block_sector_t,
+                         const struct block_iovec *, size_t iov_cnt,
+                         block_done_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
+
+/* Buckets in a latency histogram.  Bucket 0 counts requests that
+   took under 1 us, bucket I > 0 those that took at least 2**(I-1)
+   and under 2**I us, and the last bucket everything longer. */
+#define BLOCK_LATENCY_BUCKETS 24
+
+/* I/O statistics for a block device.  Requests are timed from
+   submission to completion and counted against the device they
+   were submitted to; queue depth is tracked by the device whose
+   dispatcher carries them out. */
+struct block_stats
+  {
+    unsigned long long read_cnt;        /* Sectors read. */
+    unsigned long long write_cnt;       /* Sectors written. */
+    unsigned long long requests;        /* Requests completed. */
+    int64_t wait_us;                    /* Time queued for the device. */
+    int64_t device_us;                  /* Time being carried out. */
+    unsigned long long read_latency[BLOCK_LATENCY_BUCKETS];
+    unsigned long long write_latency[BLOCK_LATENCY_BUCKETS];
+    unsigned long long class_requests[BLOCK_IOPRIO_CNT]; /* Requests
+                                           completed, by class. */
+    int64_t class_wait_us[BLOCK_IOPRIO_CNT]; /* Time queued, by class. */
+
+    int depth;                          /* Requests queued or in progress. */
+    int max_depth;                      /* Most at once. */
+    unsigned long long queued;          /* Requests queued. */
+    unsigned long long depth_sum;       /* Sum of DEPTH as each was queued. */
+  };
+
+void block_get_stats (struct block *, struct block_stats *);
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
@@ -65,10 +168,24 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*flush) (void *aux);          /* Optional. */
+
+    /* Optional.  Transfer the sectors starting at the given one,
+       as many as the pieces add up to, in as few commands as
+       the device allows. */
+    void (*readv) (void *aux, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
+    void (*writev) (void *aux, block_sector_t,
+                    const struct block_iovec *, size_t iov_cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
 
+struct block_queue *block_queue_create (const char *name);
+void block_set_queue (struct block *, struct block_queue *);
+void block_stack (struct block *upper, struct block *lower,
+                  block_sector_t start);
+
 #endif /* devices/block.h */
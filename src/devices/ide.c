@@ -8,10 +8,24 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the controller is a PCI bus-master IDE controller, such as
+   the PIIX that QEMU emulates, data moves by DMA and the disk
+   interrupts once per command.  Otherwise, or if DMA fails, it
+   moves by PIO through the data register.
+
+   At boot, each channel is reset and probed by a thread of its
+   own, so that waiting for the disks on one channel does not
+   hold up the other.  The disks found are registered afterward,
+   in order, so that device names and roles don't depend on
+   which channel finished first. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -34,6 +48,25 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Value read from the status register of a channel with nothing
+   attached: the bus floats high. */
+#define STA_NO_DEVICE 0xff
+
+/* Bus master IDE port addresses, relative to the channel's
+   bus master base. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus Master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus Master Status Register bits. */
+#define BM_ST_ERR 0x02          /* Error. */
+#define BM_ST_INTR 0x04         /* Interrupt. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +82,38 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* The 48-bit LBA forms of the READ and WRITE commands, for
+   sectors past the 28-bit limit. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT. */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT. */
+#define CMD_READ_MULTIPLE_EXT 0x29      /* READ MULTIPLE EXT. */
+#define CMD_WRITE_MULTIPLE_EXT 0x39     /* WRITE MULTIPLE EXT. */
+#define CMD_READ_DMA_EXT 0x25           /* READ DMA EXT. */
+#define CMD_WRITE_DMA_EXT 0x35          /* WRITE DMA EXT. */
+
+/* Sectors reachable with 28-bit LBA. */
+#define LBA28_SECTORS (1UL << 28)
+
+/* Waits on a device.  Polling starts every POLL_MIN_US
+   microseconds, so that a quick device (as a virtual one nearly
+   always is) is noticed at once, and backs off to POLL_MAX_US
+   for a slow one.  A device may stay busy for RESET_TIMEOUT_US
+   after a reset, as the ATA standards allow, but one that shows
+   no sign of being there is given only ABSENT_TIMEOUT_US. */
+#define POLL_MIN_US 10
+#define POLL_MAX_US 10000
+#define RESET_TIMEOUT_US (30 * 1000 * 1000)
+#define ABSENT_TIMEOUT_US (100 * 1000)
+
+/* Most sectors one READ or WRITE command can move.  A sector
+   count register of 0 means this many. */
+#define MAX_SECTORS_PER_COMMAND 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,8 +122,32 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per interrupt for READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    bool dma;                   /* Transfer by bus-master DMA? */
+    bool lba48;                 /* Supports 48-bit LBA? */
+    block_sector_t capacity;    /* Size in sectors, once identified. */
+    char info[128];             /* Model, serial number, DMA use. */
   };
 
+/* A Physical Region Descriptor, which tells the bus master
+   controller about one physically contiguous piece of a DMA
+   transfer.  A piece may not cross a PRD_BOUNDARY boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Bytes, or 0 for PRD_BOUNDARY. */
+    uint16_t flags;             /* PRD_EOT on the last descriptor. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_BOUNDARY 0x10000    /* Regions may not cross 64 kB. */
+
+/* Descriptors in a channel's one-page PRD table.  A command moves
+   at most MAX_SECTORS_PER_COMMAND sectors, each of which takes at
+   most two descriptors, so this is always enough. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
 struct channel
@@ -72,24 +161,39 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    struct block_queue *queue;  /* Dispatches the disks' requests. */
+
+    uint16_t bm_base;           /* Bus master base port, or 0 if none. */
+    struct prd *prdt;           /* PRD table for DMA transfers. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
+    struct semaphore *probed;   /* Up'd when probing at boot is done. */
   };
 
+/* -bigdisk: Use IDE disks of 1 GB or more? */
+bool ide_allow_large;
+
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static void register_ata_device (struct ata_disk *);
+static thread_func probe_channel;
+static void set_multiple_mode (struct ata_disk *, uint8_t cnt);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static bool select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
+static void poll_sleep (int64_t *delay);
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
@@ -101,11 +205,16 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
+  struct semaphore probed;
   size_t chan_no;
 
+  sema_init (&probed, 0);
+
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
+      char thread_name[16];
       int dev_no;
 
       /* Initialize channel. */
@@ -126,6 +235,18 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->queue = NULL;
+
+      /* Set up DMA if there is a bus master controller.  Each
+         channel has 8 bytes of bus master ports. */
+      c->bm_base = 0;
+      c->prdt = NULL;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (0);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -141,20 +262,116 @@ ide_init (void)
       /* Register interrupt handler. */
       intr_register_ext (c->irq, interrupt_handler, c->name);
 
-      /* Reset hardware. */
-      reset_channel (c);
+      /* Reset and probe the channel in the background.  If no
+         thread can be had, do it here. */
+      c->probed = &probed;
+      snprintf (thread_name, sizeof thread_name, "ide%zu-probe", chan_no);
+      if (thread_create (thread_name, PRI_DEFAULT, probe_channel, c)
+          == TID_ERROR)
+        probe_channel (c);
+    }
 
-      /* Distinguish ATA hard disks from other devices. */
-      if (check_device_type (&c->devices[0]))
-        check_device_type (&c->devices[1]);
+  /* Wait for every channel, then register the disks found. */
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    sema_down (&probed);
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      int dev_no;
 
-      /* Read hard disk identity information. */
       for (dev_no = 0; dev_no < 2; dev_no++)
-        if (c->devices[dev_no].is_ata)
-          identify_ata_device (&c->devices[dev_no]);
+        if (channels[chan_no].devices[dev_no].is_ata)
+          register_ata_device (&channels[chan_no].devices[dev_no]);
     }
 }
+
+/* Resets channel C_, finds the ATA disks on it, and reads their
+   identity information, then ups C_'s PROBED semaphore. */
+static void
+probe_channel (void *c_)
+{
+  struct channel *c = c_;
+  int dev_no;
+
+  /* Reset hardware. */
+  reset_channel (c);
+
+  /* Distinguish ATA hard disks from other devices. */
+  if (check_device_type (&c->devices[0]))
+    check_device_type (&c->devices[1]);
+
+  /* Read hard disk identity information. */
+  for (dev_no = 0; dev_no < 2; dev_no++)
+    if (c->devices[dev_no].is_ata)
+      identify_ata_device (&c->devices[dev_no]);
+
+  sema_up (c->probed);
+}
 
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Returns the 32-bit PCI configuration register at byte offset
+   REG of function FUNC of device DEV on bus BUS. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg)
+{
+  outl (PCI_CONFIG_ADDRESS,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit PCI configuration register at byte offset REG
+   of function FUNC of device DEV on bus BUS to DATA. */
+static void
+pci_write_config (int bus, int dev, int func, int reg, uint32_t data)
+{
+  outl (PCI_CONFIG_ADDRESS,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, data);
+}
+
+/* Looks on PCI bus 0 for a bus-master IDE controller that drives
+   the legacy channels, such as the PIIX in a PC or in QEMU.  If
+   one is found, allows it to master the bus and returns its bus
+   master base port.  Otherwise, returns 0. */
+static uint16_t
+find_bus_master (void)
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class, bar4;
+        uint8_t prog_if;
+
+        if ((pci_read_config (0, dev, func, 0x00) & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 1, subclass 1 is an IDE controller.  Bit 7 of its
+           programming interface says it can master the bus; bits 0
+           and 2 say a channel has moved off its legacy ports,
+           which we don't support. */
+        class = pci_read_config (0, dev, func, 0x08);
+        prog_if = class >> 8;
+        if ((class >> 16) != 0x0101 || (prog_if & 0x80) == 0
+            || (prog_if & 0x05) != 0)
+          continue;
+
+        /* BAR4 holds the bus master ports' base in I/O space. */
+        bar4 = pci_read_config (0, dev, func, 0x20);
+        if ((bar4 & 1) == 0 || (bar4 & ~3u) == 0)
+          continue;
+
+        /* Enable I/O space and bus mastering. */
+        pci_write_config (0, dev, func, 0x04,
+                          pci_read_config (0, dev, func, 0x04) | 0x05);
+        return bar4 & 0xfffc;
+      }
+  return 0;
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -188,15 +405,20 @@ reset_channel (struct channel *c)
                          && inb (reg_lbal (c)) == 0xaa);
     }
 
+  /* With nothing attached there is nothing to wait for. */
+  if (!present[0] && !present[1])
+    return;
+
   /* Issue soft reset sequence, which selects device 0 as a side effect.
-     Also enable interrupts. */
+     Also enable interrupts.  The devices set BSY within 2 ms of
+     the end of the sequence, and we poll for it to clear. */
   outb (reg_ctl (c), 0);
   timer_usleep (10);
   outb (reg_ctl (c), CTL_SRST);
   timer_usleep (10);
   outb (reg_ctl (c), 0);
 
-  timer_msleep (150);
+  timer_msleep (2);
 
   /* Wait for device 0 to clear BSY. */
   if (present[0]) 
@@ -205,19 +427,31 @@ reset_channel (struct channel *c)
       wait_while_busy (&c->devices[0]); 
     }
 
-  /* Wait for device 1 to clear BSY. */
+  /* Wait for device 1 to post its signature, then to clear BSY.
+     A device still in reset keeps BSY set, so if BSY is clear
+     and the signature hasn't appeared, the registers that echoed
+     our writes were device 0's and there is no device 1. */
   if (present[1])
     {
-      int i;
+      int64_t start = timer_usecs ();
+      int64_t delay = POLL_MIN_US;
 
       select_device (&c->devices[1]);
-      for (i = 0; i < 3000; i++) 
+      while (inb (reg_nsect (c)) != 1 || inb (reg_lbal (c)) != 1)
         {
-          if (inb (reg_nsect (c)) == 1 && inb (reg_lbal (c)) == 1)
-            break;
-          timer_msleep (10);
+          uint8_t status = inb (reg_alt_status (c));
+          bool busy = (status & STA_BSY) && status != STA_NO_DEVICE;
+
+          if (timer_usecs () - start
+              > (busy ? RESET_TIMEOUT_US : ABSENT_TIMEOUT_US))
+            {
+              present[1] = false;
+              break;
+            }
+          poll_sleep (&delay);
         }
-      wait_while_busy (&c->devices[1]);
+      if (present[1])
+        wait_while_busy (&c->devices[1]);
     }
 }
 
@@ -253,18 +487,15 @@ check_device_type (struct ata_disk *d)
     }
 }
 
-/* Sends an IDENTIFY DEVICE command to disk D and reads the
-   response.  Registers the disk with the block device
-   layer. */
+/* Sends an IDENTIFY DEVICE command to disk D, reads the
+   response, and sets D up to match.  Clears D's is_ata member
+   if the disk does not respond. */
 static void
 identify_ata_device (struct ata_disk *d) 
 {
   struct channel *c = d->channel;
   char id[BLOCK_SECTOR_SIZE];
-  block_sector_t capacity;
   char *model, *serial;
-  char extra_info[128];
-  struct block *block;
 
   ASSERT (d->is_ata);
 
@@ -281,34 +512,90 @@ identify_ata_device (struct ata_disk *d)
     }
   input_sector (c, id);
 
-  /* Calculate capacity.
-     Read model name and serial number. */
-  capacity = *(uint32_t *) &id[60 * 2];
+  /* Calculate capacity.  A disk that supports 48-bit LBA (bit 10
+     of word 83) gives it in words 100 to 103, others in words 60
+     and 61.  block_sector_t limits us to the first 2**32 sectors. */
+  d->lba48 = (id[83 * 2 + 1] & 0x04) != 0;
+  if (d->lba48)
+    {
+      uint64_t capacity48 = *(uint64_t *) &id[100 * 2];
+      d->capacity = capacity48 < UINT32_MAX ? capacity48 : UINT32_MAX;
+    }
+  else
+    d->capacity = *(uint32_t *) &id[60 * 2];
+
+  /* Let READ/WRITE MULTIPLE move as many sectors per interrupt
+     as the disk allows. */
+  set_multiple_mode (d, id[47 * 2]);
+
+  /* Use DMA if the disk supports it (bit 8 of IDENTIFY word 49)
+     and there is a controller to drive it. */
+  d->dma = c->bm_base != 0 && (id[49 * 2 + 1] & 0x01) != 0;
+
+  /* Read model name and serial number. */
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
-  snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+  snprintf (d->info, sizeof d->info, "model \"%s\", serial \"%s\"%s",
+            model, serial, d->dma ? ", DMA" : "");
+}
+
+/* Registers identified disk D with the block device layer. */
+static void
+register_ata_device (struct ata_disk *d)
+{
+  struct channel *c = d->channel;
+  struct block *block;
+
+  ASSERT (d->is_ata);
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
-     someone's important data.  You can disable this check by
-     hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+     someone's important data.  The -bigdisk option disables
+     this check. */
+  if (d->capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE
+      && !ide_allow_large)
     {
       printf ("%s: ignoring ", d->name);
-      print_human_readable_size (capacity * 512);
+      print_human_readable_size ((uint64_t) d->capacity * BLOCK_SECTOR_SIZE);
       printf ("disk for safety\n");
       d->is_ata = false;
       return;
     }
 
-  /* Register. */
-  block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+  /* Register.  The disks on a channel share a controller, so one
+     dispatcher carries out the requests of both. */
+  block = block_register (d->name, BLOCK_RAW, d->info, d->capacity,
                           &ide_operations, d);
+  if (c->queue == NULL)
+    c->queue = block_queue_create (c->name);
+  block_set_queue (block, c->queue);
   partition_scan (block);
 }
 
+/* Sets D's multiple count, the number of sectors that READ
+   MULTIPLE and WRITE MULTIPLE move per interrupt, to CNT if the
+   disk accepts it.  Otherwise, or if CNT is 0, multi-sector
+   transfers fall back to READ SECTOR and WRITE SECTOR, which
+   interrupt once per sector. */
+static void
+set_multiple_mode (struct ata_disk *d, uint8_t cnt)
+{
+  struct channel *c = d->channel;
+
+  d->multiple = 0;
+  if (cnt == 0)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_status (c)) & STA_ERR) == 0)
+    d->multiple = cnt;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,68 +624,296 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* A position within a scatter/gather list. */
+struct iov_cursor
+  {
+    const struct block_iovec *iov;      /* The list. */
+    size_t seg;                         /* Current piece. */
+    block_sector_t ofs;                 /* Sector within the piece. */
+  };
+
+/* Returns the buffer for the sector at CUR and advances CUR past
+   it. */
+static uint8_t *
+next_sector (struct iov_cursor *cur)
+{
+  while (cur->ofs == cur->iov[cur->seg].cnt)
+    {
+      cur->seg++;
+      cur->ofs = 0;
+    }
+  return ((uint8_t *) cur->iov[cur->seg].buffer
+          + cur->ofs++ * BLOCK_SECTOR_SIZE);
+}
+
+/* Moves CNT sectors, from 1 to MAX_SECTORS_PER_COMMAND, between
+   disk D, starting at SEC_NO, and the buffers at CUR by PIO,
+   advancing CUR past them.  Uses READ/WRITE MULTIPLE if the disk
+   supports it, so that it interrupts once per D->multiple
+   sectors, and READ/WRITE SECTOR otherwise.  D's channel must be
+   locked. */
+static void
+pio_transfer (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+              struct iov_cursor *cur, bool write)
+{
+  struct channel *c = d->channel;
+  block_sector_t per_intr = 1;
+  block_sector_t done, i;
+  uint8_t command;
+  bool ext;
+
+  ext = select_sector (d, sec_no, cnt);
+  if (cnt > 1 && d->multiple > 0)
+    {
+      per_intr = d->multiple;
+      if (write)
+        command = ext ? CMD_WRITE_MULTIPLE_EXT : CMD_WRITE_MULTIPLE;
+      else
+        command = ext ? CMD_READ_MULTIPLE_EXT : CMD_READ_MULTIPLE;
+    }
+  else if (write)
+    command = ext ? CMD_WRITE_SECTOR_EXT : CMD_WRITE_SECTOR_RETRY;
+  else
+    command = ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR_RETRY;
+  issue_pio_command (c, command);
+  for (done = 0; done < cnt; done += per_intr)
+    {
+      block_sector_t n = cnt - done < per_intr ? cnt - done : per_intr;
+
+      /* A read interrupts when each block of data is ready; a
+         write interrupts after the disk has taken it. */
+      if (!write)
+        sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+               write ? "write" : "read", sec_no + done);
+      for (i = 0; i < n; i++)
+        if (write)
+          output_sector (c, next_sector (cur));
+        else
+          input_sector (c, next_sector (cur));
+      if (write)
+        sema_down (&c->completion_wait);
+    }
+}
+
+/* Returns the number of bytes that PRD describes. */
+static size_t
+prd_size (const struct prd *prd)
+{
+  return prd->size != 0 ? prd->size : PRD_BOUNDARY;
+}
+
+/* Moves CNT sectors, from 1 to MAX_SECTORS_PER_COMMAND, between
+   disk D, starting at SEC_NO, and the buffers at CUR by
+   bus-master DMA, advancing CUR past them.  The buffers must be
+   in kernel memory, as for all block requests, because vtop()
+   can only translate kernel addresses.  The calling thread
+   sleeps until the single completion interrupt.  D's channel
+   must be locked.
+
+   Returns true if successful.  On failure, turns off DMA for D,
+   leaves CUR alone, and returns false, so that the caller can
+   redo the transfer by PIO. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+              struct iov_cursor *cur, bool write)
+{
+  struct channel *c = d->channel;
+  struct iov_cursor next = *cur;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+  size_t prd_cnt = 0;
+  uint8_t bm_status;
+  block_sector_t i;
+
+  /* Describe the buffers to the controller, merging physically
+     adjacent ones.  No region may cross a 64 kB boundary, so a
+     sector that straddles one takes two. */
+  for (i = 0; i < cnt; i++)
+    {
+      uintptr_t addr = vtop (next_sector (&next));
+      size_t left = BLOCK_SECTOR_SIZE;
+
+      while (left > 0)
+        {
+          struct prd *last = prd_cnt > 0 ? &c->prdt[prd_cnt - 1] : NULL;
+          size_t size = PRD_BOUNDARY - addr % PRD_BOUNDARY;
+          if (size > left)
+            size = left;
+
+          if (last != NULL && last->addr + prd_size (last) == addr
+              && addr % PRD_BOUNDARY != 0)
+            last->size = prd_size (last) + size;
+          else
+            {
+              ASSERT (prd_cnt < PRD_CNT);
+              c->prdt[prd_cnt].addr = addr;
+              c->prdt[prd_cnt].size = size;
+              c->prdt[prd_cnt].flags = 0;
+              prd_cnt++;
+            }
+          addr += size;
+          left -= size;
+        }
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+  /* Start the transfer and sleep until it completes. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_ST_ERR | BM_ST_INTR);
+  if (select_sector (d, sec_no, cnt))
+    issue_pio_command (c, write ? CMD_WRITE_DMA_EXT : CMD_READ_DMA_EXT);
+  else
+    issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), direction);
+
+  /* Writing back the error and interrupt bits clears them. */
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status);
+  if ((bm_status & BM_ST_ERR) != 0
+      || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+    {
+      printf ("%s: DMA failed, sector=%"PRDSNu", using PIO\n",
+              d->name, sec_no);
+      d->dma = false;
+      return false;
+    }
+
+  *cur = next;
+  return true;
+}
+
+/* Moves consecutive sectors between disk D, starting at SEC_NO,
+   and the IOV_CNT pieces of IOV: into them if WRITE is false,
+   out of them if it is true.  Each run of up to
+   MAX_SECTORS_PER_COMMAND sectors takes a single command, by
+   bus-master DMA if the disk and its controller support it and
+   by PIO otherwise.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_transfer (struct ata_disk *d, block_sector_t sec_no,
+              const struct block_iovec *iov, size_t iov_cnt, bool write)
 {
-  struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  struct iov_cursor cur = { iov, 0, 0 };
+  block_sector_t left = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    left += iov[i].cnt;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (left > 0)
+    {
+      block_sector_t cnt = (left < MAX_SECTORS_PER_COMMAND
+                            ? left : MAX_SECTORS_PER_COMMAND);
+
+      if (!d->dma || !dma_transfer (d, sec_no, cnt, &cur, write))
+        pio_transfer (d, sec_no, cnt, &cur, write);
+      sec_no += cnt;
+      left -= cnt;
+    }
   lock_release (&c->lock);
 }
 
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  struct block_iovec iov = { buffer, 1 };
+  ide_transfer (d, sec_no, &iov, 1, false);
+}
+
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
    acknowledged receiving the data.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  struct block_iovec iov = { (void *) buffer, 1 };
+  ide_transfer (d, sec_no, &iov, 1, true);
+}
+
+/* Reads consecutive sectors from disk D, starting at SEC_NO,
+   into the IOV_CNT pieces of IOV. */
+static void
+ide_readv (void *d, block_sector_t sec_no,
+           const struct block_iovec *iov, size_t iov_cnt)
+{
+  ide_transfer (d, sec_no, iov, iov_cnt, false);
+}
+
+/* Writes consecutive sectors to disk D, starting at SEC_NO, from
+   the IOV_CNT pieces of IOV.  Returns after the disk has
+   acknowledged receiving all of the data. */
+static void
+ide_writev (void *d, block_sector_t sec_no,
+            const struct block_iovec *iov, size_t iov_cnt)
+{
+  ide_transfer (d, sec_no, iov, iov_cnt, true);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    NULL,
+    ide_readv,
+    ide_writev
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+   writes SEC_NO to the disk's sector selection registers and
+   CNT, from 1 to MAX_SECTORS_PER_COMMAND, to its sector count
+   register.  (We use LBA mode.)  Returns true if the sectors
+   reach past the 28-bit limit, so that the registers hold a
+   48-bit address and the command must be an EXT one. */
+static bool
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
+  bool ext = sec_no >= LBA28_SECTORS || cnt > LBA28_SECTORS - sec_no;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_SECTORS_PER_COMMAND);
+  ASSERT (!ext || d->lba48);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
-  outb (reg_lbal (c), sec_no);
-  outb (reg_lbam (c), sec_no >> 8);
-  outb (reg_lbah (c), (sec_no >> 16));
-  outb (reg_device (c),
-        DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+  if (ext)
+    {
+      /* Each register is a two-deep FIFO: the high-order byte
+         goes in first, then the low-order byte.  LBA bits 32 to
+         47 are always 0 for a block_sector_t. */
+      outb (reg_nsect (c), cnt >> 8);
+      outb (reg_lbal (c), sec_no >> 24);
+      outb (reg_lbam (c), 0);
+      outb (reg_lbah (c), 0);
+      outb (reg_nsect (c), cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), sec_no >> 16);
+      outb (reg_device (c),
+            DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+    }
+  else
+    {
+      outb (reg_nsect (c), cnt == MAX_SECTORS_PER_COMMAND ? 0 : cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), (sec_no >> 16));
+      outb (reg_device (c), (DEV_MBS | DEV_LBA
+                             | (d->dev_no == 1 ? DEV_DEV : 0)
+                             | (sec_no >> 24)));
+    }
+  return ext;
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -452,27 +967,51 @@ wait_until_idle (const struct ata_disk *d)
   printf ("%s: idle timeout\n", d->name);
 }
 
+/* Sleeps for *DELAY microseconds between polls of a device,
+   then doubles *DELAY, up to POLL_MAX_US. */
+static void
+poll_sleep (int64_t *delay) 
+{
+  timer_usleep (*delay);
+  *delay = *delay * 2 < POLL_MAX_US ? *delay * 2 : POLL_MAX_US;
+}
+
 /* Wait up to 30 seconds for disk D to clear BSY,
    and then return the status of the DRQ bit.
    The ATA standards say that a disk may take as long as that to
-   complete its reset. */
+   complete its reset.  Returns false at once if nothing is
+   attached to D's channel. */
 static bool
 wait_while_busy (const struct ata_disk *d) 
 {
   struct channel *c = d->channel;
-  int i;
-  
-  for (i = 0; i < 3000; i++)
+  int64_t start = timer_usecs ();
+  int64_t delay = POLL_MIN_US;
+  bool warned = false;
+
+  for (;;)
     {
-      if (i == 700)
-        printf ("%s: busy, waiting...", d->name);
-      if (!(inb (reg_alt_status (c)) & STA_BSY)) 
+      uint8_t status = inb (reg_alt_status (c));
+      int64_t waited;
+
+      if (status == STA_NO_DEVICE)
+        return false;
+      if (!(status & STA_BSY)) 
         {
-          if (i >= 700)
+          if (warned)
             printf ("ok\n");
           return (inb (reg_alt_status (c)) & STA_DRQ) != 0;
         }
-      timer_msleep (10);
+
+      waited = timer_usecs () - start;
+      if (waited > RESET_TIMEOUT_US)
+        break;
+      if (!warned && waited > 7 * 1000 * 1000)
+        {
+          printf ("%s: busy, waiting...", d->name);
+          warned = true;
+        }
+      poll_sleep (&delay);
     }
 
   printf ("failed\n");
@@ -0,0 +1,163 @@
+#include "devices/iotrace.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* A record of buffer cache and block requests, for tuning the
+   cache offline.
+
+   With -iotrace=N, the last N requests are kept in a ring
+   buffer in memory.  At shutdown the ring is written to the end
+   of the scratch device, a header sector followed by the
+   entries, oldest first, where src/utils/cachesim can find it
+   and replay it against other cache sizes and policies.  The
+   end of the device is used so that files appended to the
+   scratch device's archive are left alone. */
+
+/* Entries per sector of a saved trace. */
+#define ENTRIES_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (struct iotrace_entry))
+
+/* Ring buffer of entries, or a null pointer if not tracing. */
+static struct iotrace_entry *ring;
+static size_t ring_size;        /* Number of entries in RING. */
+static uint64_t record_cnt;     /* Entries recorded, including those
+                                   since overwritten. */
+
+/* Starts tracing into a ring buffer of ENTRY_CNT entries, or does
+   nothing if ENTRY_CNT is 0.  Panics if memory runs out. */
+void
+iotrace_init (size_t entry_cnt)
+{
+  ASSERT (ring == NULL);
+  if (entry_cnt == 0)
+    return;
+
+  ring = malloc (entry_cnt * sizeof *ring);
+  if (ring == NULL)
+    PANIC ("iotrace: couldn't allocate %zu entries", entry_cnt);
+  ring_size = entry_cnt;
+  record_cnt = 0;
+}
+
+/* Records a request of kind OP, from the running thread, for the
+   CNT sectors starting at SECTOR of device DEV.  Does nothing
+   unless tracing.  May be called with interrupts off. */
+void
+iotrace_record (enum iotrace_op op, unsigned dev, block_sector_t sector,
+                block_sector_t cnt, uint8_t flags)
+{
+  struct thread *t;
+  struct iotrace_entry *e;
+  enum intr_level old_level;
+
+  t = thread_current ();
+  old_level = intr_disable ();
+  if (ring != NULL)
+    {
+      e = &ring[record_cnt++ % ring_size];
+      e->usecs = timer_usecs ();
+      e->sector = sector;
+      e->cnt = cnt;
+      e->inode = t->trace_inode;
+      e->tid = t->tid;
+      e->op = op;
+      e->dev = dev;
+      e->flags = flags;
+      memset (e->reserved, 0, sizeof e->reserved);
+    }
+  intr_set_level (old_level);
+}
+
+/* Sets the inode that the running thread's requests are on
+   behalf of to INODE, which may be IOTRACE_NO_INODE.  Returns
+   the previous inode. */
+block_sector_t
+iotrace_set_inode (block_sector_t inode)
+{
+  struct thread *t = thread_current ();
+  block_sector_t old = t->trace_inode;
+
+  t->trace_inode = inode;
+  return old;
+}
+
+/* Stops tracing and writes the trace to the end of the scratch
+   device.  If the device is too small for all of it, the oldest
+   entries are left out. */
+void
+iotrace_dump (void)
+{
+  struct iotrace_entry *entries = ring;
+  struct iotrace_header *h;
+  struct block *scratch, *block;
+  uint64_t first;
+  size_t cnt, sector_cnt, i;
+  block_sector_t start;
+  uint8_t *buffer;
+
+  /* Stop recording, so that writing the trace isn't traced. */
+  if (entries == NULL)
+    return;
+  ring = NULL;
+
+  scratch = block_get_role (BLOCK_SCRATCH);
+  buffer = malloc (BLOCK_SECTOR_SIZE);
+  if (scratch == NULL || buffer == NULL)
+    {
+      printf ("iotrace: no %s, trace not saved\n",
+              scratch == NULL ? "scratch device" : "memory");
+      free (buffer);
+      free (entries);
+      return;
+    }
+
+  /* Keep the newest entries that fit. */
+  cnt = record_cnt < ring_size ? record_cnt : ring_size;
+  if (block_size (scratch) < 2)
+    cnt = 0;
+  else if (cnt > (block_size (scratch) - 1) * ENTRIES_PER_SECTOR)
+    cnt = (block_size (scratch) - 1) * ENTRIES_PER_SECTOR;
+  first = record_cnt - cnt;
+  sector_cnt = DIV_ROUND_UP (cnt, ENTRIES_PER_SECTOR);
+  start = block_size (scratch) - 1 - sector_cnt;
+
+  /* Write the header, naming each device by its number. */
+  memset (buffer, 0, BLOCK_SECTOR_SIZE);
+  h = (struct iotrace_header *) buffer;
+  memcpy (h->magic, IOTRACE_MAGIC, sizeof h->magic);
+  h->entry_cnt = cnt;
+  h->lost_cnt = record_cnt - cnt;
+  for (block = block_first ();
+       block != NULL && h->dev_cnt < IOTRACE_MAX_DEVS;
+       block = block_next (block))
+    strlcpy (h->devs[h->dev_cnt++], block_name (block), sizeof *h->devs);
+  block_write (scratch, start, buffer);
+
+  /* Write the entries, oldest first. */
+  for (i = 0; i < sector_cnt; i++)
+    {
+      size_t j;
+
+      memset (buffer, 0, BLOCK_SECTOR_SIZE);
+      for (j = 0; j < ENTRIES_PER_SECTOR; j++)
+        {
+          uint64_t n = first + i * ENTRIES_PER_SECTOR + j;
+          if (n == record_cnt)
+            break;
+          memcpy (buffer + j * sizeof *entries, &entries[n % ring_size],
+                  sizeof *entries);
+        }
+      block_write (scratch, start + 1 + i, buffer);
+    }
+
+  printf ("iotrace: saved %zu requests (%"PRIu64" lost) to %s "
+          "at sector %"PRDSNu".\n",
+          cnt, record_cnt - cnt, block_name (scratch), start);
+  free (buffer);
+  free (entries);
+}
@@ -0,0 +1,64 @@
+#ifndef DEVICES_IOTRACE_H
+#define DEVICES_IOTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+/* Kinds of traced requests. */
+enum iotrace_op
+  {
+    IOTRACE_CACHE_READ,         /* Buffer cache read. */
+    IOTRACE_CACHE_WRITE,        /* Buffer cache write. */
+    IOTRACE_BLOCK_READ,         /* Block device read. */
+    IOTRACE_BLOCK_WRITE         /* Block device write. */
+  };
+
+/* Trace entry flags. */
+#define IOTRACE_MISS 0x01       /* Cache request missed. */
+
+/* Inode of requests made outside any inode's reads and writes. */
+#define IOTRACE_NO_INODE UINT32_MAX
+
+/* Device of cache requests, whose sectors include their
+   volume's base. */
+#define IOTRACE_CACHE_DEV 0xff
+
+/* Most devices named in a trace header. */
+#define IOTRACE_MAX_DEVS 16
+
+/* First sector of a saved trace, which the entries follow, oldest
+   first.  This and struct iotrace_entry are the trace file
+   format, so src/utils/cachesim.c must agree with them. */
+#define IOTRACE_MAGIC "IOTRACE1"
+struct iotrace_header
+  {
+    char magic[8];              /* IOTRACE_MAGIC, without a null. */
+    uint32_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lost_cnt;          /* Entries overwritten or left out. */
+    uint32_t dev_cnt;           /* Number of names in devs. */
+    char devs[IOTRACE_MAX_DEVS][16]; /* Device names, by number. */
+  };
+
+/* One traced request. */
+struct iotrace_entry
+  {
+    int64_t usecs;              /* Time of request, from timer_usecs(). */
+    uint32_t sector;            /* First sector. */
+    uint32_t cnt;               /* Number of sectors, or for a cache
+                                   request, sectors per cache entry. */
+    uint32_t inode;             /* Inode sector, or IOTRACE_NO_INODE. */
+    int32_t tid;                /* Requesting thread. */
+    uint8_t op;                 /* An enum iotrace_op. */
+    uint8_t dev;                /* Device number or IOTRACE_CACHE_DEV. */
+    uint8_t flags;              /* IOTRACE_* flags. */
+    uint8_t reserved[5];        /* Zeros. */
+  };
+
+void iotrace_init (size_t entry_cnt);
+void iotrace_record (enum iotrace_op, unsigned dev, block_sector_t sector,
+                     block_sector_t cnt, uint8_t flags);
+block_sector_t iotrace_set_inode (block_sector_t inode);
+void iotrace_dump (void);
+
+#endif /* devices/iotrace.h */
@@ -181,7 +181,9 @@ found_partition (struct block *block, uint8_t part_type,
       snprintf (name, sizeof name, "%s%d", block_name (block), part_nr);
       snprintf (extra_info, sizeof extra_info, "%s (%02x)",
                 partition_type_name (part_type), part_type);
-      block_register (name, type, extra_info, size, &partition_operations, p);
+      block_stack (block_register (name, type, extra_info, size,
+                                   &partition_operations, p),
+                   block, start);
     }
 }
 
@@ -320,5 +322,8 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    NULL,
+    NULL,
+    NULL
   };
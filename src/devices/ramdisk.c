@@ -0,0 +1,86 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in memory.
+
+   Its sectors live in pages taken from the kernel pool, which
+   need not be contiguous, so the disk's size is limited only by
+   free memory.  Transfers are plain copies that complete before
+   returning, so the disk has no request queue and no seek or PIO
+   costs, and everything on it is lost at shutdown.  Give it a
+   role with -filesys, -scratch or -swap. */
+
+/* Sectors per page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The RAM disk's pages. */
+static uint8_t **pages;
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a zeroed RAM disk of KB kilobytes, rounded up to a
+   whole page, and registers it as "ram0".  Panics if memory
+   runs out. */
+void
+ramdisk_init (size_t kb)
+{
+  size_t page_cnt = DIV_ROUND_UP (kb * 1024, PGSIZE);
+  size_t i;
+
+  ASSERT (pages == NULL);
+  if (page_cnt == 0)
+    return;
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ramdisk: out of memory for page table");
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ramdisk: out of memory after %zu kB", i * PGSIZE / 1024);
+    }
+
+  block_register ("ram0", BLOCK_RAW, "RAM disk",
+                  page_cnt * SECTORS_PER_PAGE, &ramdisk_operations, NULL);
+}
+
+/* Returns the address of SECTOR's data. */
+static uint8_t *
+sector_data (block_sector_t sector)
+{
+  return (pages[sector / SECTORS_PER_PAGE]
+          + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *aux UNUSED, block_sector_t sector, void *buffer)
+{
+  memcpy (buffer, sector_data (sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *aux UNUSED, block_sector_t sector, const void *buffer)
+{
+  memcpy (sector_data (sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    NULL,
+    NULL,
+    NULL
+  };
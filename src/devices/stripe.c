@@ -0,0 +1,260 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* A striped (RAID-0) block device.
+
+   The device's sectors are split into chunks of a fixed size,
+   which are dealt out to the member devices in turn: chunk 0 to
+   the first member, chunk 1 to the second, and so on, wrapping
+   around.  A transfer that spans several chunks is split into
+   one request per chunk, all submitted before waiting for any,
+   so that members with their own dispatchers (disks on
+   different IDE channels) work in parallel.  Chunks that land
+   next to each other on a member are merged by its elevator. */
+
+/* Most member devices. */
+#define STRIPE_MAX_MEMBERS 8
+
+/* Default chunk size in bytes. */
+#define STRIPE_DEFAULT_CHUNK (64 * 1024)
+
+/* Requests and buffer pieces in flight at once for one
+   transfer.  Larger transfers proceed in rounds. */
+#define STRIPE_BATCH 8
+#define STRIPE_PIECES 32
+
+struct stripe
+  {
+    struct block *members[STRIPE_MAX_MEMBERS]; /* Member devices. */
+    size_t member_cnt;                  /* Number of members. */
+    block_sector_t chunk;               /* Sectors per chunk. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* Creates a striped device from SPEC, which has the form
+   BDEV,BDEV[,...][:BYTES]: the names of two or more member
+   devices, then optionally the chunk size in bytes, a multiple
+   of BLOCK_SECTOR_SIZE, which defaults to 64 kB.  Registers the
+   device as "md0", a file system device, and returns it.  Panics
+   if SPEC is invalid. */
+struct block *
+stripe_create (char *spec)
+{
+  struct stripe *s;
+  char *names, *bytes, *name, *save_ptr;
+  block_sector_t member_chunks = 0;
+  char extra_info[128];
+  size_t i, chunk_bytes;
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("Failed to allocate memory for stripe descriptor");
+
+  names = strtok_r (spec, ":", &save_ptr);
+  bytes = strtok_r (NULL, "", &save_ptr);
+  chunk_bytes = bytes != NULL ? (size_t) atoi (bytes) : STRIPE_DEFAULT_CHUNK;
+  if (chunk_bytes == 0 || chunk_bytes % BLOCK_SECTOR_SIZE != 0)
+    PANIC ("stripe: chunk size %zu is not a multiple of %d bytes",
+           chunk_bytes, BLOCK_SECTOR_SIZE);
+  s->chunk = chunk_bytes / BLOCK_SECTOR_SIZE;
+
+  s->member_cnt = 0;
+  for (name = strtok_r (names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *block = block_get_by_name (name);
+      block_sector_t chunks;
+
+      if (block == NULL)
+        PANIC ("stripe: no such block device \"%s\"", name);
+      if (block_type (block) == BLOCK_FOREIGN)
+        PANIC ("stripe: %s belongs to another operating system", name);
+      for (i = 0; i < s->member_cnt; i++)
+        if (s->members[i] == block)
+          PANIC ("stripe: %s listed twice", name);
+      if (s->member_cnt == STRIPE_MAX_MEMBERS)
+        PANIC ("stripe: more than %d members", STRIPE_MAX_MEMBERS);
+
+      /* Every member holds as many chunks as the smallest. */
+      chunks = block_size (block) / s->chunk;
+      if (s->member_cnt == 0 || chunks < member_chunks)
+        member_chunks = chunks;
+      s->members[s->member_cnt++] = block;
+    }
+  if (s->member_cnt < 2)
+    PANIC ("stripe: need at least two member devices");
+  if (member_chunks == 0)
+    PANIC ("stripe: members are smaller than one chunk");
+
+  snprintf (extra_info, sizeof extra_info,
+            "stripe of %zu devices, %zu-byte chunks",
+            s->member_cnt, chunk_bytes);
+  return block_register ("md0", BLOCK_FILESYS, extra_info,
+                         member_chunks * s->chunk * s->member_cnt,
+                         &stripe_operations, s);
+}
+
+/* Stores into *MEMBER the member of S that holds SECTOR and into
+   *MEMBER_SECTOR its position there. */
+static void
+stripe_map (const struct stripe *s, block_sector_t sector,
+            struct block **member, block_sector_t *member_sector)
+{
+  block_sector_t chunk = sector / s->chunk;
+
+  *member = s->members[chunk % s->member_cnt];
+  *member_sector = chunk / s->member_cnt * s->chunk + sector % s->chunk;
+}
+
+/* Reads sector SECTOR from stripe S into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+stripe_read (void *s, block_sector_t sector, void *buffer)
+{
+  struct block *member;
+  block_sector_t member_sector;
+
+  stripe_map (s, sector, &member, &member_sector);
+  block_read (member, member_sector, buffer);
+}
+
+/* Write sector SECTOR to stripe S from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the member has
+   acknowledged receiving the data. */
+static void
+stripe_write (void *s, block_sector_t sector, const void *buffer)
+{
+  struct block *member;
+  block_sector_t member_sector;
+
+  stripe_map (s, sector, &member, &member_sector);
+  block_write (member, member_sector, buffer);
+}
+
+/* Flushes every member of stripe S_. */
+static void
+stripe_flush (void *s_)
+{
+  struct stripe *s = s_;
+  size_t i;
+
+  for (i = 0; i < s->member_cnt; i++)
+    block_flush (s->members[i]);
+}
+
+/* Completion function for the requests of stripe_transfer(). */
+static void
+member_done (struct block_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Moves consecutive sectors of stripe S, starting at SECTOR, into
+   the IOV_CNT pieces of IOV if WRITE is false or out of them if
+   it is true.  Each chunk's worth goes to its member as a
+   separate request, and up to STRIPE_BATCH of them are in flight
+   at once. */
+static void
+stripe_transfer (struct stripe *s, block_sector_t sector,
+                 const struct block_iovec *iov, size_t iov_cnt, bool write)
+{
+  struct block_request requests[STRIPE_BATCH];
+  struct block_iovec pieces[STRIPE_PIECES];
+  size_t request_cnt = 0, piece_cnt = 0;
+  struct semaphore done;
+  size_t seg = 0;
+  block_sector_t seg_ofs = 0;
+  block_sector_t left = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    left += iov[i].cnt;
+
+  sema_init (&done, 0);
+  while (left > 0)
+    {
+      block_sector_t chunk_left = s->chunk - sector % s->chunk;
+      block_sector_t cnt = left < chunk_left ? left : chunk_left;
+      block_sector_t covered = 0;
+      size_t first_piece;
+      struct block *member;
+      block_sector_t member_sector;
+
+      /* Wait for the last round if it used up our slots. */
+      if (request_cnt == STRIPE_BATCH || piece_cnt == STRIPE_PIECES)
+        {
+          for (i = 0; i < request_cnt; i++)
+            sema_down (&done);
+          request_cnt = piece_cnt = 0;
+        }
+
+      /* Gather this chunk's share of IOV, or as much of it as
+         there are free pieces for. */
+      first_piece = piece_cnt;
+      while (covered < cnt && piece_cnt < STRIPE_PIECES)
+        {
+          block_sector_t n;
+
+          while (seg_ofs == iov[seg].cnt)
+            {
+              seg++;
+              seg_ofs = 0;
+            }
+          n = iov[seg].cnt - seg_ofs;
+          if (n > cnt - covered)
+            n = cnt - covered;
+          pieces[piece_cnt].buffer = ((uint8_t *) iov[seg].buffer
+                                      + seg_ofs * BLOCK_SECTOR_SIZE);
+          pieces[piece_cnt].cnt = n;
+          piece_cnt++;
+          seg_ofs += n;
+          covered += n;
+        }
+
+      stripe_map (s, sector, &member, &member_sector);
+      block_request_init (&requests[request_cnt], write, member_sector,
+                          pieces + first_piece, piece_cnt - first_piece,
+                          member_done, &done);
+      block_submit (member, &requests[request_cnt++]);
+
+      sector += covered;
+      left -= covered;
+    }
+
+  for (i = 0; i < request_cnt; i++)
+    sema_down (&done);
+}
+
+/* Reads consecutive sectors of stripe S, starting at SECTOR,
+   into the IOV_CNT pieces of IOV. */
+static void
+stripe_readv (void *s, block_sector_t sector,
+              const struct block_iovec *iov, size_t iov_cnt)
+{
+  stripe_transfer (s, sector, iov, iov_cnt, false);
+}
+
+/* Writes consecutive sectors of stripe S, starting at SECTOR,
+   from the IOV_CNT pieces of IOV. */
+static void
+stripe_writev (void *s, block_sector_t sector,
+               const struct block_iovec *iov, size_t iov_cnt)
+{
+  stripe_transfer (s, sector, iov, iov_cnt, true);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_flush,
+    stripe_readv,
+    stripe_writev
+  };
@@ -24,11 +24,22 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Time-stamp counter cycles per microsecond, and the counter and
+   tick count at the same moment.  Initialized by
+   timer_calibrate(). */
+static uint64_t cycles_per_usec;
+static uint64_t calibrate_tsc;
+static int64_t calibrate_ticks;
+
+/* Timer ticks over which to count time-stamp counter cycles. */
+#define TSC_CALIBRATE_TICKS 4
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static uint64_t rdtsc (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -64,6 +75,19 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Count time-stamp counter cycles between tick boundaries. */
+  calibrate_ticks = ticks;
+  while (ticks == calibrate_ticks)
+    barrier ();
+  calibrate_ticks = ticks;
+  calibrate_tsc = rdtsc ();
+  while (ticks - calibrate_ticks < TSC_CALIBRATE_TICKS)
+    barrier ();
+  cycles_per_usec = ((rdtsc () - calibrate_tsc) * TIMER_FREQ
+                     / TSC_CALIBRATE_TICKS / 1000000);
+  if (cycles_per_usec == 0)
+    cycles_per_usec = 1;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,6 +108,18 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of microseconds since the OS booted.  Once
+   timer_calibrate() has run, this has the resolution of the
+   CPU's time-stamp counter rather than of timer ticks. */
+int64_t
+timer_usecs (void)
+{
+  if (cycles_per_usec == 0)
+    return timer_ticks () * (1000000 / TIMER_FREQ);
+  return (calibrate_ticks * (1000000 / TIMER_FREQ)
+          + (int64_t) ((rdtsc () - calibrate_tsc) / cycles_per_usec));
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
@@ -193,6 +229,15 @@ too_many_loops (unsigned loops)
   return start != ticks;
 }
 
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Iterates through a simple loop LOOPS times, for implementing
    brief delays.
 
@@ -24,38 +24,36 @@ list_dir (const char *dir, bool verbose)
 
   if (isdir (dir_fd))
     {
-      char name[READDIR_MAX_LEN];
-
       printf ("%s", dir);
       if (verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
+      if (verbose)
         {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+          /* Fetch entries together with their attributes, many
+             at a time, instead of opening each one. */
+          struct readdir_entry entries[16];
+          int cnt, i;
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+          while ((cnt = readdirplus (dir_fd, entries,
+                                     sizeof entries / sizeof *entries)) > 0)
+            for (i = 0; i < cnt; i++)
+              {
+                printf ("%s: ", entries[i].name);
+                if (entries[i].is_dir)
+                  printf ("directory");
+                else
+                  printf ("%d-byte file", entries[i].size);
+                printf (", inumber %d\n", entries[i].inumber);
+              }
+        }
+      else
+        {
+          char name[READDIR_MAX_LEN + 1];
 
-              printf (": ");
-              if (entry_fd != -1)
-                {
-                  if (isdir (entry_fd))
-                    printf ("directory");
-                  else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
-                }
-              else
-                printf ("open failed");
-              close (entry_fd);
-            }
-          printf ("\n");
+          while (readdir (dir_fd, name)) 
+            printf ("%s\n", name); 
         }
     }
   else 
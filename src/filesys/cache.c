@@ -1,20 +1,51 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
+#include "devices/iotrace.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define CACHE_SIZE 64
 
+/* Identifies the warm-up list in WARMUP_SECTOR. */
+#define WARMUP_MAGIC 0x5741524d
+
+/* Most clusters the warm-up list can name. */
+#define WARMUP_MAX 126
+
+/* Most clusters waiting to be prefetched. */
+#define PREFETCH_MAX 32
+
+/* Each entry holds one whole cluster, so a miss reads in
+   every sector of it at once. */
 struct cache_entry 
 {
-  char data[BLOCK_SECTOR_SIZE];
-  block_sector_t sector;
+  uint8_t *data;                      /* fs_cluster_sectors sectors */
+  block_sector_t sector;              /* first sector of the cluster */
 
-  bool dirty;                         /* dirty bit */
+  uint32_t dirty;                     /* dirty bit per sector */
+  unsigned hits;                      /* accesses since filled */
   bool access;                        /* reference bit */
   bool valid;                         /* valid or invalid entry */
 };
 
+/* The clusters that were hottest at the last clean shutdown,
+   kept in WARMUP_SECTOR of the root volume.  Must be exactly
+   BLOCK_SECTOR_SIZE bytes long. */
+struct warmup_disk
+{
+  uint32_t magic;                     /* WARMUP_MAGIC */
+  uint32_t cnt;                       /* number of clusters */
+  block_sector_t sectors[WARMUP_MAX]; /* first sectors, ascending */
+};
+
 
 /* Cache entries. */
 static struct cache_entry cache[CACHE_SIZE];
@@ -22,99 +53,653 @@ static struct cache_entry cache[CACHE_SIZE];
 /* A lock for synchronizing cache operations. */
 static struct lock cache_lock;
 
+/* Set by cache_close() to stop the warm-up and prefetch
+   threads. */
+static bool cache_closing;
+
+/* Bumped whenever a sector's contents may change other than in
+   its cache entry, so that a cluster read without cache_lock
+   held can be checked for being stale before it is cached.
+   Protected by cache_lock. */
+static unsigned cache_gen;
+
+/* Clusters for the prefetch thread to read in, a ring of
+   first sectors. Protected by cache_lock. */
+static block_sector_t prefetch_queue[PREFETCH_MAX];
+static size_t prefetch_head;
+static size_t prefetch_cnt;
+static struct condition prefetch_cond;
+
+static void prefetch_thread (void *);
+
+static void cache_write_back (struct cache_entry *);
+static void cache_fill (struct cache_entry *, block_sector_t);
+static void cache_patch (block_sector_t, const void *, bool before);
+
 /**
- * Init the cache.
+ * Return the volume holding sector, which is an inode
+ * number, i.e. includes its volume's base.
+ */
+static struct volume *
+cache_volume (block_sector_t sector)
+{
+  struct volume *vol = volume_of (sector);
+  ASSERT (vol != NULL);
+  return vol;
+}
+
+/**
+ * Read sector from its device, or from the journal if
+ * it holds a newer copy.
+ */
+static void
+cache_read_sector (block_sector_t sector, void *target)
+{
+  struct volume *vol = cache_volume (sector);
+  if (!vol->journaled || !journal_read (sector, target))
+    block_read (vol->device, sector - vol->base, target);
+}
+
+/**
+ * Write sector to its device.
+ */
+static void
+cache_write_sector (block_sector_t sector, const void *source)
+{
+  struct volume *vol = cache_volume (sector);
+  block_write (vol->device, sector - vol->base, source);
+}
+
+/**
+ * Read cnt consecutive sectors starting at sector into
+ * target with as few device commands as possible, then
+ * replace any the journal holds newer copies of.
+ */
+static void
+cache_read_run (block_sector_t sector, size_t cnt, uint8_t *target)
+{
+  struct volume *vol = cache_volume (sector);
+  size_t i;
+  block_read_multiple (vol->device, sector - vol->base, cnt, target);
+  if (vol->journaled)
+    for (i = 0; i < cnt; i++)
+      journal_read (sector + i, target + i * BLOCK_SECTOR_SIZE);
+}
+
+/**
+ * Write cnt consecutive sectors starting at sector from
+ * source with as few device commands as possible.
+ */
+static void
+cache_write_run (block_sector_t sector, size_t cnt, const uint8_t *source)
+{
+  struct volume *vol = cache_volume (sector);
+  block_write_multiple (vol->device, sector - vol->base, cnt, source);
+}
+
+/**
+ * Init the cache. The cluster size must be known.
  */
 void
 cache_init (void)
 {
   lock_init (&cache_lock);
+  cond_init (&prefetch_cond);
 
   int i;
   for (i = 0; i < CACHE_SIZE; i++)
   {
     cache[i].valid = false;
+    cache[i].data = malloc (FS_CLUSTER_SIZE);
+    if (cache[i].data == NULL)
+      PANIC ("can't allocate buffer cache");
   }
+
+  thread_create ("cache-prefetch", PRI_DEFAULT, prefetch_thread, NULL);
+}
+
+/**
+ * Orders cache entries by hits, most first.
+ */
+static int
+compare_hits (const void *a_, const void *b_)
+{
+  const struct cache_entry *a = *(const struct cache_entry **) a_;
+  const struct cache_entry *b = *(const struct cache_entry **) b_;
+  return a->hits < b->hits ? 1 : a->hits > b->hits ? -1 : 0;
+}
+
+/**
+ * Orders sector numbers, lowest first.
+ */
+static int
+compare_sectors (const void *a_, const void *b_)
+{
+  block_sector_t a = *(const block_sector_t *) a_;
+  block_sector_t b = *(const block_sector_t *) b_;
+  return a < b ? -1 : a > b;
+}
+
+/**
+ * Save the clusters of the root volume that have been hit
+ * most since they were read in, in sector order, so the
+ * next boot can read them back. Must be called with
+ * cache_lock held.
+ */
+static void
+cache_save_warmup (void)
+{
+  struct cache_entry *hot[CACHE_SIZE];
+  struct warmup_disk list;
+  size_t cnt = 0;
+  int i;
+
+  ASSERT (sizeof list == BLOCK_SECTOR_SIZE);
+  for (i = 0; i < CACHE_SIZE; i++)
+  {
+    if (cache[i].valid && cache[i].hits > 0
+        && volume_of (cache[i].sector) == volume_get (0))
+      hot[cnt++] = &cache[i];
+  }
+  qsort (hot, cnt, sizeof *hot, compare_hits);
+
+  memset (&list, 0, sizeof list);
+  list.magic = WARMUP_MAGIC;
+  list.cnt = cnt < WARMUP_MAX ? cnt : WARMUP_MAX;
+  for (i = 0; i < (int) list.cnt; i++)
+    list.sectors[i] = hot[i]->sector;
+  qsort (list.sectors, list.cnt, sizeof *list.sectors, compare_sectors);
+  block_write (fs_device, WARMUP_SECTOR, &list);
 }
 
 /**
  * Close the cache. Must write back
- * the dirty entry.
+ * the dirty entry. The hottest clusters
+ * are remembered for cache_warmup().
  */
 void
 cache_close (void)
 {
+  cache_flush ();
+
   lock_acquire (&cache_lock);
+  cache_closing = true;
+  prefetch_cnt = 0;
+  if (fs_warmup)
+    cache_save_warmup ();
+  lock_release (&cache_lock);
+}
+
+/**
+ * Return a cache entry that holds nothing, or NULL if
+ * every entry is in use. Must be called with cache_lock
+ * held.
+ */
+static struct cache_entry *
+cache_free_entry (void)
+{
   int i;
   for (i = 0; i < CACHE_SIZE; i++)
+    if (!cache[i].valid)
+      return &cache[i];
+  return NULL;
+}
+
+/**
+ * Read the clusters on the warm-up list into free cache
+ * entries. Entries already in use are never evicted
+ * for it, so it only fills a cold cache. Each cluster
+ * is read into a private buffer without cache_lock, so
+ * no one waits on the idle-class read, and is only
+ * cached if nothing changed it meanwhile.
+ */
+static void
+warmup_thread (void *list_)
+{
+  struct warmup_disk *list = list_;
+  uint8_t *buffer = malloc (FS_CLUSTER_SIZE);
+  size_t i;
+
+  /* Warming up must not hold back real requests. */
+  block_set_ioprio (BLOCK_IOPRIO_IDLE);
+  for (i = 0; buffer != NULL && i < list->cnt; i++)
   {
-    if (cache[i].valid)
+    block_sector_t sector = list->sectors[i];
+    struct cache_entry *temp;
+    unsigned gen;
+    bool stop, cached;
+
+    lock_acquire (&cache_lock);
+    stop = cache_closing || cache_free_entry () == NULL;
+    cached = cache_find (sector) != NULL;
+    gen = cache_gen;
+    lock_release (&cache_lock);
+    if (stop)
+      break;
+    if (cached)
+      continue;
+
+    cache_read_run (sector, fs_cluster_sectors, buffer);
+
+    lock_acquire (&cache_lock);
+    temp = cache_free_entry ();
+    if (!cache_closing && temp != NULL && gen == cache_gen
+        && cache_find (sector) == NULL)
     {
-      if (cache[i].dirty)
-      {
-        block_write (fs_device, cache[i].sector, cache[i].data);
-        cache[i].dirty = false;
-      }
+      /* Trade buffers instead of copying. */
+      uint8_t *data = temp->data;
+      temp->data = buffer;
+      buffer = data;
+      temp->valid = true;
+      temp->sector = sector;
+      temp->dirty = 0;
+      temp->hits = 0;
+      temp->access = false;
     }
+    lock_release (&cache_lock);
+  }
+  free (buffer);
+  free (list);
+}
+
+/**
+ * Start reading in, in the background, the clusters that
+ * were hottest at the last clean shutdown. The journal
+ * must already be replayed.
+ */
+void
+cache_warmup (void)
+{
+  struct warmup_disk *list;
+  size_t i;
+
+  if (!fs_warmup)
+    return;
+  list = malloc (sizeof *list);
+  if (list == NULL)
+    return;
+  block_read (fs_device, WARMUP_SECTOR, list);
+  if (list->magic != WARMUP_MAGIC || list->cnt > WARMUP_MAX)
+    list->cnt = 0;
+
+  /* Drop anything that does not start a root volume cluster. */
+  for (i = 0; i < list->cnt; i++)
+    if (list->sectors[i] % fs_cluster_sectors != 0
+        || list->sectors[i] >= block_size (fs_device))
+      list->cnt = 0;
+
+  if (list->cnt == 0)
+  {
+    free (list);
+    return;
+  }
+  printf ("cache: warming up %"PRIu32" clusters\n", list->cnt);
+  if (thread_create ("cache-warmup", PRI_DEFAULT, warmup_thread,
+                     list) == TID_ERROR)
+    free (list);
+}
+
+/**
+ * Write back every dirty entry.
+ */
+void
+cache_flush (void)
+{
+  lock_acquire (&cache_lock);
+  int i;
+  for (i = 0; i < CACHE_SIZE; i++)
+  {
+    if (cache[i].valid)
+      cache_write_back (&cache[i]);
   }  
 
+  struct volume *vol;
+  size_t v;
+  for (v = 0; (vol = volume_get (v)) != NULL; v++)
+    block_flush (vol->device);
   lock_release (&cache_lock);
 }
 
 /**
- * Read cache entry.
+ * Write back sector's cluster if any of it is dirty.
+ * The device may still be holding the writes; see
+ * block_flush().
  */
 void
-cache_read (block_sector_t sector, void *target)
+cache_sync (block_sector_t sector)
 {
   lock_acquire (&cache_lock);
   struct cache_entry *temp = cache_find (sector);
+  if (temp != NULL)
+    cache_write_back (temp);
+  lock_release (&cache_lock);
+}
+
+/**
+ * Write the dirty sectors of entry back to disk.
+ */
+static void
+cache_write_back (struct cache_entry *entry)
+{
+  size_t i = 0;
+  while (i < fs_cluster_sectors)
+  {
+    // Each run of consecutive dirty sectors goes out as one write.
+    size_t start;
+    if (!(entry->dirty & (1u << i)))
+    {
+      i++;
+      continue;
+    }
+    start = i;
+    while (i < fs_cluster_sectors && (entry->dirty & (1u << i)))
+      i++;
+    cache_gen++;
+    cache_write_run (entry->sector + start, i - start,
+                     entry->data + start * BLOCK_SECTOR_SIZE);
+  }
+  entry->dirty = 0;
+}
+
+/**
+ * Fill entry from the cluster starting at sector.
+ * The journal may hold a newer copy than the disk.
+ */
+static void
+cache_fill (struct cache_entry *entry, block_sector_t sector)
+{
+  entry->valid = true;
+  entry->sector = sector;
+  entry->dirty = 0;
+  entry->hits = 0;
+  cache_read_run (sector, fs_cluster_sectors, entry->data);
+}
+
+/**
+ * Return the entry holding sector's cluster, reading
+ * the cluster in on a miss. Store the sector's offset
+ * within the cluster's data into *ofs. The access is
+ * traced as a read or, if write, a write.
+ */
+static struct cache_entry *
+cache_get (block_sector_t sector, size_t *ofs, bool write)
+{
+  struct cache_entry *temp = cache_find (sector);
+  iotrace_record (write ? IOTRACE_CACHE_WRITE : IOTRACE_CACHE_READ,
+                  IOTRACE_CACHE_DEV, sector, fs_cluster_sectors,
+                  temp == NULL ? IOTRACE_MISS : 0);
   if (temp == NULL)
   {
     temp = cache_evict ();
-    temp->valid = true;
-    temp->sector = sector;
-    block_read (fs_device, sector, temp->data);
+    cache_fill (temp, sector - sector % fs_cluster_sectors);
   }
 
   temp->access = true;
-  memcpy (target, temp->data, BLOCK_SECTOR_SIZE);
+  temp->hits++;
+  *ofs = sector - temp->sector;
+  return temp;
+}
+
+/**
+ * Read cache entry.
+ */
+void
+cache_read (block_sector_t sector, void *target)
+{
+  size_t ofs;
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_get (sector, &ofs, false);
+  memcpy (target, temp->data + ofs * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
   lock_release (&cache_lock);
 }
 
+/**
+ * Read a metadata sector through the cache. Lookups wait
+ * on metadata, so a miss is read in the realtime I/O class,
+ * unless the thread is doing idle-class background work.
+ */
+void
+cache_read_meta (block_sector_t sector, void *target)
+{
+  enum block_ioprio old = block_set_ioprio (BLOCK_IOPRIO_RT);
+  if (old == BLOCK_IOPRIO_IDLE)
+    block_set_ioprio (old);
+  cache_read (sector, target);
+  block_set_ioprio (old);
+}
+
 /**
  * Write to cache.
  */
 void
 cache_write (block_sector_t sector, void *source)
+{
+  size_t ofs;
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_get (sector, &ofs, true);
+  temp->dirty |= 1u << ofs;
+  memcpy (temp->data + ofs * BLOCK_SECTOR_SIZE, source, BLOCK_SECTOR_SIZE);
+  lock_release (&cache_lock);
+}
+
+/**
+ * Write metadata to cache. The sector is logged in
+ * the journal, which writes it home after commit,
+ * so the sector stays clean. Volumes without a journal
+ * get an ordinary dirty write.
+ */
+void
+cache_write_meta (block_sector_t sector, void *source)
+{
+  size_t ofs;
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_get (sector, &ofs, true);
+  if (cache_volume (sector)->journaled)
+  {
+    journal_add (sector, source);
+    temp->dirty &= ~(1u << ofs);
+    cache_gen++;
+  }
+  else
+    temp->dirty |= 1u << ofs;
+  memcpy (temp->data + ofs * BLOCK_SECTOR_SIZE, source, BLOCK_SECTOR_SIZE);
+  lock_release (&cache_lock);
+}
+
+/**
+ * Read a sector for direct I/O. A cached copy is
+ * used if there is one, since it may be newer than
+ * the disk, but a miss reads straight into target
+ * without taking a cache entry, or holding cache_lock,
+ * since the read may be in the idle class. Target goes
+ * to the device as is, so it must be in kernel memory.
+ */
+void
+cache_read_direct (block_sector_t sector, void *target)
 {
   lock_acquire (&cache_lock);
   struct cache_entry *temp = cache_find (sector);
+  if (temp != NULL)
+  {
+    size_t ofs = sector - temp->sector;
+    memcpy (target, temp->data + ofs * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+  }
+  lock_release (&cache_lock);
   if (temp == NULL)
+    cache_read_sector (sector, target);
+}
+
+/**
+ * Write a sector for direct I/O straight to disk.
+ * Source must be in kernel memory, like target for
+ * cache_read_direct(). A cached copy is updated as
+ * well so cached readers stay coherent. Once nothing in its cluster is dirty
+ * the entry is dropped, so a stream of direct writes
+ * into freshly zeroed clusters leaves the cache alone.
+ * cache_lock is not held across the write.
+ */
+void
+cache_write_direct (block_sector_t sector, const void *source)
+{
+  cache_patch (sector, source, true);
+  cache_write_sector (sector, source);
+  cache_patch (sector, source, false);
+}
+
+/**
+ * Bring the cached copy of a sector that is being written
+ * around the cache up to date with source, if its cluster
+ * is cached. Called before the write, so that writing
+ * back an older dirty copy can't land on top of it, and
+ * after, in case the cluster was read in meanwhile. By
+ * then a dirty copy is newer and is left alone, and an
+ * entry with nothing dirty is dropped.
+ */
+static void
+cache_patch (block_sector_t sector, const void *source, bool before)
+{
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_find (sector);
+  if (before)
+    cache_gen++;
+  if (temp != NULL)
   {
-    temp = cache_evict ();
-    temp->valid = true;
-    temp->sector = sector;
-    block_read (fs_device, sector, temp->data);
+    size_t ofs = sector - temp->sector;
+    if (before || !(temp->dirty & (1u << ofs)))
+    {
+      memcpy (temp->data + ofs * BLOCK_SECTOR_SIZE, source, BLOCK_SECTOR_SIZE);
+      temp->dirty &= ~(1u << ofs);
+    }
+    if (!before && temp->dirty == 0)
+      temp->valid = false;
   }
+  lock_release (&cache_lock);
+}
 
-  temp->access = true;
-  temp->dirty = true;
-  memcpy (temp->data, source, BLOCK_SECTOR_SIZE);
+/**
+ * Ask for sector's cluster to be read into the cache in
+ * the background. Does nothing if it is already cached
+ * or queued, or if too many clusters are queued already.
+ */
+void
+cache_prefetch (block_sector_t sector)
+{
+  block_sector_t start = sector - sector % fs_cluster_sectors;
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  if (cache_closing || prefetch_cnt >= PREFETCH_MAX
+      || cache_find (start) != NULL)
+    goto done;
+  for (i = 0; i < prefetch_cnt; i++)
+  {
+    if (prefetch_queue[(prefetch_head + i) % PREFETCH_MAX] == start)
+      goto done;
+  }
+  prefetch_queue[(prefetch_head + prefetch_cnt++) % PREFETCH_MAX] = start;
+  cond_signal (&prefetch_cond, &cache_lock);
+
+ done:
+  lock_release (&cache_lock);
+}
+
+/**
+ * Read queued clusters into the cache. A prefetched
+ * entry starts without its reference bit, so it is
+ * the first to go if nobody reads it. As in
+ * warmup_thread(), each cluster is read into a private
+ * buffer without cache_lock, so that the reader who
+ * asked for it isn't stuck behind the read on its next
+ * access, and is only cached if nothing changed or
+ * cached it meanwhile.
+ */
+static void
+prefetch_thread (void *aux UNUSED)
+{
+  uint8_t *buffer = malloc (FS_CLUSTER_SIZE);
+
+  /* Someone asked for the data and will want it soon. */
+  block_set_ioprio (BLOCK_IOPRIO_BE);
+  if (buffer == NULL)
+    return;
+
+  lock_acquire (&cache_lock);
+  while (true)
+  {
+    while (prefetch_cnt == 0)
+      cond_wait (&prefetch_cond, &cache_lock);
+
+    block_sector_t sector = prefetch_queue[prefetch_head];
+    prefetch_head = (prefetch_head + 1) % PREFETCH_MAX;
+    prefetch_cnt--;
+    if (cache_find (sector) != NULL)
+      continue;
+
+    unsigned gen = cache_gen;
+    lock_release (&cache_lock);
+    cache_read_run (sector, fs_cluster_sectors, buffer);
+    lock_acquire (&cache_lock);
+
+    if (!cache_closing && gen == cache_gen && cache_find (sector) == NULL)
+    {
+      struct cache_entry *temp = cache_evict ();
+
+      /* Trade buffers instead of copying. */
+      uint8_t *data = temp->data;
+      temp->data = buffer;
+      buffer = data;
+      temp->valid = true;
+      temp->sector = sector;
+      temp->dirty = 0;
+      temp->hits = 0;
+      temp->access = false;
+    }
+  }
+}
+
+/**
+ * Drop sector's cluster from the cache unless some of
+ * it is dirty.
+ */
+void
+cache_discard (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_find (sector);
+  if (temp != NULL && temp->dirty == 0)
+    temp->valid = false;
+  lock_release (&cache_lock);
+}
+
+/**
+ * Clear the reference bit of sector's cluster, so the
+ * clock takes it before anything used since.
+ */
+void
+cache_demote (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  struct cache_entry *temp = cache_find (sector);
+  if (temp != NULL)
+    temp->access = false;
   lock_release (&cache_lock);
 }
 
 /**
- * Find the cache entry, return the pointer of 
- * the entry if hit, else NULL.
+ * Find the cache entry holding sector's cluster, return
+ * the pointer of the entry if hit, else NULL.
  */
 struct cache_entry *
 cache_find (block_sector_t sector)
 {
+  block_sector_t start = sector - sector % fs_cluster_sectors;
   int i;
   for (i = 0; i < CACHE_SIZE; i++)
   {
-    if (cache[i].valid && cache[i].sector == sector)
+    if (cache[i].valid && cache[i].sector == start)
     {
       return &(cache[i]);
     }
@@ -144,11 +729,7 @@ cache_evict (void)
   }
 
   struct cache_entry *temp = &cache[clock];
-  if (temp->dirty)
-  {
-    block_write (fs_device, temp->sector, temp->data);
-    temp->dirty = false;
-  }
+  cache_write_back (temp);
   temp->valid = false;
   return temp;
 }
\ No newline at end of file
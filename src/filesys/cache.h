@@ -5,8 +5,18 @@
 
 void cache_init (void);
 void cache_read (block_sector_t sector, void *target);
+void cache_read_meta (block_sector_t sector, void *target);
 void cache_write (block_sector_t sector, void *source);
+void cache_write_meta (block_sector_t sector, void *source);
+void cache_read_direct (block_sector_t sector, void *target);
+void cache_prefetch (block_sector_t sector);
+void cache_discard (block_sector_t sector);
+void cache_demote (block_sector_t sector);
+void cache_write_direct (block_sector_t sector, const void *source);
+void cache_sync (block_sector_t sector);
+void cache_flush (void);
 void cache_close (void);
+void cache_warmup (void);
 struct cache_entry *cache_evict (void);
 struct cache_entry *cache_find (block_sector_t sector);
 
@@ -0,0 +1,207 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Number of path components remembered at once. */
+#define DCACHE_SIZE 128
+
+/* Marks a negative entry's SECTOR. */
+#define DCACHE_NO_SECTOR ((block_sector_t) -1)
+
+/* A cached directory entry: NAME inside the directory whose
+   inode lives in PARENT resolves to SECTOR, or to nothing at
+   all for a negative entry. */
+struct dcache_entry
+  {
+    struct hash_elem hash_elem;         /* Element in dcache_table. */
+    struct list_elem lru_elem;          /* Element in lru_list or free_list. */
+    block_sector_t parent;              /* Inode sector of the directory. */
+    char name[NAME_MAX + 1];            /* Null terminated component. */
+    block_sector_t sector;              /* Inode sector or DCACHE_NO_SECTOR. */
+  };
+
+/* Entries, the table indexing the live ones, and the lists
+   ordering them from most to least recently used and holding
+   the unused ones. */
+static struct dcache_entry entries[DCACHE_SIZE];
+static struct hash dcache_table;
+static struct list lru_list;
+static struct list free_list;
+
+/* Protects everything above. */
+static struct lock dcache_lock;
+
+static hash_hash_func dcache_hash;
+static hash_less_func dcache_less;
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  lock_init (&dcache_lock);
+  hash_init (&dcache_table, dcache_hash, dcache_less, NULL);
+  list_init (&lru_list);
+  list_init (&free_list);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&free_list, &entries[i].lru_elem);
+}
+
+/* Returns the live entry for NAME in PARENT, or a null pointer.
+   Must be called with dcache_lock held. */
+static struct dcache_entry *
+find (block_sector_t parent, const char *name)
+{
+  struct dcache_entry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dcache_table, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dcache_entry, hash_elem) : NULL;
+}
+
+/* Drops entry E from the table and returns it to the free list.
+   Must be called with dcache_lock held. */
+static void
+discard (struct dcache_entry *e)
+{
+  hash_delete (&dcache_table, &e->hash_elem);
+  list_remove (&e->lru_elem);
+  list_push_back (&free_list, &e->lru_elem);
+}
+
+/* Records that NAME in PARENT resolves to SECTOR, replacing
+   anything already known about it and evicting the least
+   recently used entry if the cache is full. */
+static void
+store (block_sector_t parent, const char *name, block_sector_t sector)
+{
+  struct dcache_entry *e;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  e = find (parent, name);
+  if (e == NULL)
+    {
+      if (list_empty (&free_list))
+        discard (list_entry (list_back (&lru_list),
+                             struct dcache_entry, lru_elem));
+      e = list_entry (list_pop_front (&free_list),
+                      struct dcache_entry, lru_elem);
+      e->parent = parent;
+      strlcpy (e->name, name, sizeof e->name);
+      hash_insert (&dcache_table, &e->hash_elem);
+    }
+  else
+    list_remove (&e->lru_elem);
+  e->sector = sector;
+  list_push_front (&lru_list, &e->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Looks up NAME in the directory whose inode is in PARENT.
+   On DCACHE_POSITIVE, sets *SECTOR to the inode sector that NAME
+   refers to. */
+enum dcache_result
+dcache_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sector)
+{
+  enum dcache_result result = DCACHE_MISS;
+  struct dcache_entry *e;
+
+  lock_acquire (&dcache_lock);
+  e = find (parent, name);
+  if (e != NULL)
+    {
+      list_remove (&e->lru_elem);
+      list_push_front (&lru_list, &e->lru_elem);
+      if (e->sector == DCACHE_NO_SECTOR)
+        result = DCACHE_NEGATIVE;
+      else
+        {
+          *sector = e->sector;
+          result = DCACHE_POSITIVE;
+        }
+    }
+  lock_release (&dcache_lock);
+  return result;
+}
+
+/* Remembers that NAME in PARENT is the inode in SECTOR. */
+void
+dcache_insert (block_sector_t parent, const char *name, block_sector_t sector)
+{
+  store (parent, name, sector);
+}
+
+/* Remembers that PARENT has no entry called NAME. */
+void
+dcache_insert_negative (block_sector_t parent, const char *name)
+{
+  store (parent, name, DCACHE_NO_SECTOR);
+}
+
+/* Forgets anything known about NAME in PARENT. */
+void
+dcache_invalidate (block_sector_t parent, const char *name)
+{
+  struct dcache_entry *e;
+
+  lock_acquire (&dcache_lock);
+  e = find (parent, name);
+  if (e != NULL)
+    discard (e);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every entry inside the directory whose inode is in
+   PARENT.  Used when that directory is removed, since its
+   sector may later be reused by an unrelated directory. */
+void
+dcache_purge_dir (block_sector_t parent)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  for (e = list_begin (&lru_list); e != list_end (&lru_list); e = next)
+    {
+      struct dcache_entry *d = list_entry (e, struct dcache_entry, lru_elem);
+      next = list_next (e);
+      if (d->parent == parent)
+        discard (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Hashes an entry by its directory and name. */
+static unsigned
+dcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dcache_entry *d = hash_entry (e, struct dcache_entry,
+                                             hash_elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+/* Orders entries by directory, then by name. */
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dcache_entry *a = hash_entry (a_, struct dcache_entry,
+                                             hash_elem);
+  const struct dcache_entry *b = hash_entry (b_, struct dcache_entry,
+                                             hash_elem);
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -2,11 +2,41 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 
+/* Directories with fewer slots than this are left alone by
+   dir_remove() even when mostly empty. */
+#define DIR_COMPACT_MIN 32
+
+/* Locking.
+
+   Each directory inode has a lock, dir_lock, that covers its
+   entries and the free slot hint and entry count kept with it.
+   It is held for the whole of dir_lookup(), dir_add(),
+   dir_remove(), dir_compact() and the readdir functions, so
+   namespace operations in different directories proceed in
+   parallel while two creators in one directory cannot both
+   claim the same name or slot.
+
+   Path resolution holds at most one directory lock at a time.
+   Operations that touch two directories lock the ancestor
+   before the descendant: dir_add() locks a new subdirectory
+   after its parent to set its ".." entry, and dir_remove()
+   locks the directory being removed after its parent to check
+   that it is empty.  Never acquire a directory lock while
+   holding the lock of one of its descendants.
+
+   The dentry cache, the open inode list, the free map and the
+   buffer cache have their own locks.  These are always taken
+   after any directory lock and never held while acquiring
+   one. */
+
 /* A directory. */
 struct dir 
   {
@@ -22,6 +52,23 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Returns the inode number that sector numbers stored in
+   INODE's directory entries are relative to.  Entries hold
+   sectors local to their own volume, so that a volume reads the
+   same whichever index it is mounted with. */
+static block_sector_t
+entry_base (const struct inode *inode)
+{
+  return inode->vol != NULL ? inode->vol->base : 0;
+}
+
+/* Returns the inode number that entry E of DIR refers to. */
+static block_sector_t
+entry_inumber (const struct dir *dir, const struct dir_entry *e)
+{
+  return entry_base (dir->inode) + e->inode_sector;
+}
+
 /* 
  * Split the path to get the directory and filename
  */
@@ -66,7 +113,9 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 
   struct dir *dir = dir_open(inode_open(sector));
   struct dir_entry e;
-  e.inode_sector = sector;
+  if (dir == NULL)
+    return false;
+  e.inode_sector = sector - entry_base (dir->inode);
   if (inode_write_at(dir->inode, &e, sizeof e, 0) != sizeof e) {
     success = false;
   }
@@ -106,6 +155,14 @@ dir_open_root (void)
 /* Opens the directory for given path. */
 struct dir *
 dir_open_directory (const char *path)
+{
+  return dir_open_directory_at (NULL, path);
+}
+
+/* Opens the directory for given path, resolving a relative path
+   from BASE, or from the current directory if BASE is null. */
+struct dir *
+dir_open_directory_at (struct dir *base, const char *path)
 {
   int path_len = strlen(path);
   char tmp_path[path_len+1];
@@ -113,7 +170,11 @@ dir_open_directory (const char *path)
 
   struct dir *cur_dir;
   struct thread *cur_thread = thread_current();
-  if(path[0] == '/' || cur_thread->cwd == NULL) 
+  if (path[0] != '/' && base != NULL)
+  {
+    cur_dir = dir_reopen(base);
+  }
+  else if(path[0] == '/' || cur_thread->cwd == NULL) 
   {
     cur_dir = dir_open_root();
   }
@@ -203,49 +264,177 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Returns the number of entries in use in the directory INODE,
+   whose dir_lock must be held.  The count is kept in the
+   in-memory inode, so only the first call after the directory
+   is opened has to scan it. */
+static int
+entry_count (struct inode *inode)
+{
+  if (inode->dir_entry_cnt < 0)
+  {
+    struct dir_entry e;
+    off_t ofs;
+    int cnt = 0;
+
+    for (ofs = sizeof e; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e)
+      if (e.in_use)
+        cnt++;
+    inode->dir_entry_cnt = cnt;
+  }
+  return inode->dir_entry_cnt;
+}
+
 /* Determine if a directory is empty or not */ 
 bool
 dir_is_empty (const struct dir *dir)
 {
+  bool is_empty;
+
+  lock_acquire (&dir->inode->dir_lock);
+  is_empty = entry_count (dir->inode) == 0;
+  lock_release (&dir->inode->dir_lock);
+  return is_empty;
+}
+
+/* Does the work of dir_compact() for DIR, whose lock must be
+   held. */
+static bool
+compact (struct dir *dir)
+{
+  struct inode *inode = dir->inode;
   struct dir_entry e;
-  off_t ofs;
+  off_t lo, hi, length;
 
-  for (ofs = sizeof e; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e)
+  if (inode->open_cnt > 1)
+    return false;
+
+  lo = sizeof e;
+  hi = inode_length (inode) / sizeof e * sizeof e - sizeof e;
+  while (lo < hi)
   {
+    /* Find the lowest free slot. */
+    if (inode_read_at (inode, &e, sizeof e, lo) != sizeof e)
+      return false;
     if (e.in_use)
+    {
+      lo += sizeof e;
+      continue;
+    }
+
+    /* Find the highest slot in use. */
+    if (inode_read_at (inode, &e, sizeof e, hi) != sizeof e)
+      return false;
+    if (!e.in_use)
+    {
+      hi -= sizeof e;
+      continue;
+    }
+
+    /* Move it down.  The dentry cache maps names to inode
+       sectors, not offsets, so it is unaffected. */
+    if (inode_write_at (inode, &e, sizeof e, lo) != sizeof e)
       return false;
+    e.in_use = false;
+    if (inode_write_at (inode, &e, sizeof e, hi) != sizeof e)
+      return false;
+    lo += sizeof e;
+    hi -= sizeof e;
   }
+
+  length = (entry_count (inode) + 1) * sizeof e;
+  if (length < inode_length (inode))
+    inode_truncate (inode, length);
+  inode->dir_free_ofs = length;
   return true;
 }
 
+/* Moves the entries of DIR into the lowest free slots and
+   shrinks the directory to fit them.  Fails, returning false,
+   if anyone else has DIR open, because moving entries would
+   disturb their dir_readdir() position. */
+bool
+dir_compact (struct dir *dir)
+{
+  bool success;
+
+  ASSERT (dir != NULL);
+
+  journal_begin ();
+  lock_acquire (&dir->inode->dir_lock);
+  success = compact (dir);
+  lock_release (&dir->inode->dir_lock);
+  journal_end ();
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   A directory with a file system mounted over it yields the root
+   of that file system. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
   struct dir_entry e;
+  block_sector_t parent, sector;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
   if (strcmp (name, ".") == 0) {
     *inode = inode_reopen (dir->inode);
+    return *inode != NULL;
+  }
+
+  /* ".." from the root of a mounted file system leaves it. */
+  if (strcmp (name, "..") == 0
+      && mount_parent (inode_get_inumber (dir->inode), &sector)) {
+    *inode = inode_open (sector);
+    return *inode != NULL;
+  }
+
+  lock_acquire (&dir->inode->dir_lock);
+
+  /* Try the dentry cache before scanning the directory. */
+  parent = inode_get_inumber (dir->inode);
+  switch (dcache_lookup (parent, name, &sector))
+  {
+    case DCACHE_POSITIVE:
+      *inode = inode_open (mount_resolve (sector));
+      goto done;
+    case DCACHE_NEGATIVE:
+      *inode = NULL;
+      goto done;
+    case DCACHE_MISS:
+      break;
   }
-  else if (strcmp (name, "..") == 0) {
+
+  if (strcmp (name, "..") == 0) {
     inode_read_at (dir->inode, &e, sizeof e, 0);
-    *inode = inode_open (e.inode_sector);
+    *inode = inode_open (entry_inumber (dir, &e));
   }
   else if (lookup (dir, name, &e, NULL)) {
-    *inode = inode_open (e.inode_sector);
+    *inode = inode_open (mount_resolve (entry_inumber (dir, &e)));
   }
   else {
     *inode = NULL;
   }
 
+  /* A removed directory's sector may be reused, so don't
+     remember anything about it. */
+  if (!dir->inode->removed) {
+    if (*inode != NULL)
+      dcache_insert (parent, name, entry_inumber (dir, &e));
+    else if (strcmp (name, "..") != 0)
+      dcache_insert_negative (parent, name);
+  }
+
+ done:
+  lock_release (&dir->inode->dir_lock);
   return *inode != NULL;
 }
 
@@ -253,8 +442,8 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), if the inode is on
+   another volume, or a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector, bool is_dir)
 {
@@ -269,32 +458,39 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector, bool is
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  lock_acquire (&dir->inode->dir_lock);
+
+  /* Check that DIR still exists and NAME is not in use.  An
+     entry can only refer to an inode on DIR's own volume. */
+  if (dir->inode->removed || lookup (dir, name, NULL, NULL)
+      || volume_of (inode_sector) != dir->inode->vol)
     goto done;
 
   /* Update the child directory */
   if (is_dir)
   {
     struct dir *child_dir = dir_open(inode_open(inode_sector));
+    bool ok;
     if (child_dir == NULL) 
       goto done;
-    e.inode_sector = inode_get_inumber(dir_get_inode(dir));
-    if (inode_write_at(child_dir->inode, &e, sizeof e, 0) != sizeof e) {
-      dir_close (child_dir);
-      goto done;
-    }
+    ok = dir_set_parent (child_dir, inode_get_inumber (dir_get_inode (dir)));
     dir_close (child_dir);
+    if (!ok)
+      goto done;
   }
 
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
-     current end-of-file.
+     current end-of-file.  No slot before the inode's free slot
+     hint is free, so start there.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = sizeof e; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  ofs = dir->inode->dir_free_ofs;
+  if (ofs < (off_t) sizeof e)
+    ofs = sizeof e;
+  for (; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (!e.in_use)
       break;
@@ -302,13 +498,41 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector, bool is
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
+  e.inode_sector = inode_sector - entry_base (dir->inode);
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+  /* Advance the free slot hint and replace any negative dentry
+     cache entry for NAME. */
+  if (success)
+  {
+    dir->inode->dir_free_ofs = ofs + sizeof e;
+    if (dir->inode->dir_entry_cnt >= 0)
+      dir->inode->dir_entry_cnt++;
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
+  }
+  else
+    dcache_invalidate (inode_get_inumber (dir->inode), name);
+
  done:
+  lock_release (&dir->inode->dir_lock);
   return success;
 }
 
+/* Makes ".." in DIR refer to the directory whose inode is
+   PARENT.  Returns true if successful, false on failure. */
+bool
+dir_set_parent (struct dir *dir, block_sector_t parent)
+{
+  struct dir_entry e;
+  bool ok;
+
+  e.inode_sector = parent - entry_base (dir->inode);
+  lock_acquire (&dir->inode->dir_lock);
+  ok = inode_write_at (dir->inode, &e, sizeof e, 0) == sizeof e;
+  lock_release (&dir->inode->dir_lock);
+  return ok;
+}
+
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
    which occurs only if there is no file with the given NAME. */
@@ -317,40 +541,61 @@ dir_remove (struct dir *dir, const char *name)
 {
   struct dir_entry e;
   struct inode *inode = NULL;
+  bool target_locked = false;
   bool success = false;
-  off_t ofs;
+  off_t ofs, slots;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  lock_acquire (&dir->inode->dir_lock);
+
+  /* Find directory entry.  A mount point stays until shutdown. */
+  if (!lookup (dir, name, &e, &ofs)
+      || mount_is_point (entry_inumber (dir, &e)))
     goto done;
 
   /* Open inode. */
-  inode = inode_open (e.inode_sector);
+  inode = inode_open (entry_inumber (dir, &e));
   if (inode == NULL)
     goto done;
 
-  /* Prevent removing non-empty directory. */
+  /* Prevent removing non-empty directory.  Keep it locked until
+     it is marked removed so nothing can be added meanwhile. */
   if (inode->data.is_dir) {
-    // target : the directory to be removed. (dir : the base directory)
-    struct dir *target = dir_open (inode);
-    bool is_empty = dir_is_empty (target);
-    dir_close (target);
-    if (! is_empty) goto done; // can't delete
+    lock_acquire (&inode->dir_lock);
+    target_locked = true;
+    if (entry_count (inode) != 0) goto done; // can't delete
   }
 
   /* Erase directory entry. */
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  if (ofs < dir->inode->dir_free_ofs)
+    dir->inode->dir_free_ofs = ofs;
+  if (dir->inode->dir_entry_cnt >= 0)
+    dir->inode->dir_entry_cnt--;
+
+  /* Forget what the removed directory contained. */
+  if (inode->data.is_dir)
+    dcache_purge_dir (inode_get_inumber (inode));
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
+  /* Shrink a directory that churn has left mostly empty. */
+  slots = inode_length (dir->inode) / sizeof e;
+  if (slots >= DIR_COMPACT_MIN && entry_count (dir->inode) * 4 < slots)
+    compact (dir);
+
  done:
+  if (target_locked)
+    lock_release (&inode->dir_lock);
+  lock_release (&dir->inode->dir_lock);
   inode_close (inode);
   return success;
 }
@@ -362,15 +607,50 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  lock_acquire (&dir->inode->dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-  return false;
+  lock_release (&dir->inode->dir_lock);
+  return found;
+}
+
+/* Reads the next directory entry in DIR and stores its name,
+   inode number, type and size in INFO.  Returns true if
+   successful, false if the directory contains no more entries. */
+bool
+dir_readdir_plus (struct dir *dir, struct dir_entry_info *info)
+{
+  struct dir_entry e;
+  bool found = false;
+
+  lock_acquire (&dir->inode->dir_lock);
+  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+    {
+      dir->pos += sizeof e;
+      if (e.in_use)
+        {
+          struct inode *inode = inode_open (entry_inumber (dir, &e));
+          if (inode == NULL)
+            continue;
+          strlcpy (info->name, e.name, sizeof info->name);
+          info->inumber = entry_inumber (dir, &e);
+          info->is_dir = inode->data.is_dir;
+          info->size = inode_length (inode);
+          inode_close (inode);
+          found = true;
+          break;
+        } 
+    }
+  lock_release (&dir->inode->dir_lock);
+  return found;
 }
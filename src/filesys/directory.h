@@ -13,6 +13,17 @@
 
 struct inode;
 
+/* A directory entry together with the attributes of the inode it
+   names, as returned by dir_readdir_plus().  The layout matches
+   struct readdir_entry in lib/user/syscall.h. */
+struct dir_entry_info
+  {
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t inumber;             /* Sector of the entry's inode. */
+    bool is_dir;                        /* Directory or ordinary file? */
+    int32_t size;                       /* File size in bytes. */
+  };
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
@@ -25,10 +36,14 @@ struct inode *dir_get_inode (struct dir *);
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t, bool is_dir); 
 bool dir_remove (struct dir *, const char *name);
+bool dir_set_parent (struct dir *, block_sector_t parent);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+bool dir_readdir_plus (struct dir *, struct dir_entry_info *);
 
 void get_directory_and_filename(const char *path, char *directory, char *filename);
 struct dir *dir_open_directory (const char *);
+struct dir *dir_open_directory_at (struct dir *base, const char *);
 bool dir_is_empty (const struct dir *);
+bool dir_compact (struct dir *);
 
 #endif /* filesys/directory.h */
@@ -1,14 +1,23 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Clusters read ahead of a sequential reader, by default and
+   for a file advised FILE_ADVICE_SEQUENTIAL. */
+#define READAHEAD_NORMAL 1
+#define READAHEAD_SEQUENTIAL 4
+
 /* An open file. */
 struct file 
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the buffer cache? */
+    enum file_advice advice;    /* Access pattern hint. */
+    off_t read_end;             /* Where the last read stopped. */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +32,9 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->direct = false;
+      file->advice = FILE_ADVICE_NORMAL;
+      file->read_end = 0;
       return file;
     }
   else
@@ -68,7 +80,7 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_at (file, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,7 +93,64 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read, end;
+
+  if (file->direct)
+    return inode_read_direct_at (file->inode, buffer, size, file_ofs);
+  bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  end = file_ofs + bytes_read;
+
+  /* Read ahead of a reader that carries on where it stopped, or
+     of any reader of a file advised to be sequential.  Clusters
+     such a file is done with are evicted first. */
+  if (file->advice == FILE_ADVICE_SEQUENTIAL)
+    {
+      inode_prefetch (file->inode, end,
+                      READAHEAD_SEQUENTIAL * FS_CLUSTER_SIZE);
+      inode_demote (file->inode, file_ofs - file_ofs % FS_CLUSTER_SIZE,
+                    end - file_ofs + file_ofs % FS_CLUSTER_SIZE);
+    }
+  else if (file->advice != FILE_ADVICE_RANDOM
+           && file_ofs == file->read_end && bytes_read > 0)
+    inode_prefetch (file->inode, end, READAHEAD_NORMAL * FS_CLUSTER_SIZE);
+  file->read_end = end;
+  return bytes_read;
+}
+
+/* Tells FILE's buffer cache policy how the LENGTH bytes at
+   OFFSET will be read, or everything from OFFSET to end of file
+   if LENGTH is 0.  FILE_ADVICE_NORMAL, FILE_ADVICE_SEQUENTIAL
+   and FILE_ADVICE_RANDOM set the read-ahead and eviction policy
+   for all of FILE and ignore the range.  FILE_ADVICE_WILLNEED
+   starts reading the range in the background, and
+   FILE_ADVICE_DONTNEED drops the clean cached parts of it.
+   Returns false if ADVICE or the range is invalid. */
+bool
+file_advise (struct file *file, off_t offset, off_t length,
+             enum file_advice advice) 
+{
+  if (offset < 0 || length < 0)
+    return false;
+  if (length == 0)
+    length = inode_length (file->inode) - offset;
+
+  switch (advice)
+    {
+    case FILE_ADVICE_NORMAL:
+    case FILE_ADVICE_SEQUENTIAL:
+    case FILE_ADVICE_RANDOM:
+      file->advice = advice;
+      return true;
+    case FILE_ADVICE_WILLNEED:
+      if (!file->direct)
+        inode_prefetch (file->inode, offset, length);
+      return true;
+    case FILE_ADVICE_DONTNEED:
+      inode_discard (file->inode, offset, length);
+      return true;
+    default:
+      return false;
+    }
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -94,7 +163,7 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_at (file, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -110,9 +179,21 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  if (file->direct)
+    return inode_write_direct_at (file->inode, buffer, size, file_ofs);
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Sets whether reads and writes through FILE bypass the buffer
+   cache.  Only sector-aligned whole sectors do; the rest of a
+   transfer still goes through the cache, and cached copies are
+   kept coherent either way. */
+void
+file_set_direct (struct file *file, bool direct)
+{
+  file->direct = direct;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
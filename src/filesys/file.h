@@ -1,10 +1,22 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
 
+/* Access pattern hints for file_advise().  The values match
+   ADVISE_* in lib/user/syscall.h. */
+enum file_advice
+  {
+    FILE_ADVICE_NORMAL,         /* No particular pattern. */
+    FILE_ADVICE_SEQUENTIAL,     /* Read front to back, once. */
+    FILE_ADVICE_RANDOM,         /* Read in no particular order. */
+    FILE_ADVICE_WILLNEED,       /* Range will be read soon. */
+    FILE_ADVICE_DONTNEED        /* Range won't be read again soon. */
+  };
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -16,6 +28,9 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+void file_set_direct (struct file *, bool);
+bool file_advise (struct file *, off_t offset, off_t length,
+                  enum file_advice);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
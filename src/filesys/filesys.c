@@ -2,35 +2,142 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
+#include "filesys/lfs.h"
+#include "filesys/mount.h"
+#include "filesys/tmpfs.h"
 #include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
-static void do_format (void);
+/* If true, do_format() lays the file system out log-structured.
+   Otherwise, an existing log-structured file system is still
+   recognized and mounted. */
+bool filesys_lfs;
+
+/* Where to mount a tmpfs, if anywhere. */
+const char *filesys_tmpfs;
+
+/* File systems on other block devices to mount at startup,
+   from "-mount=BDEV:PATH" options. */
+#define MOUNT_REQUESTS_MAX (VOLUME_MAX - 1)
+struct mount_request
+  {
+    const char *device;                 /* Block device name. */
+    const char *path;                   /* Directory to mount over. */
+  };
+static struct mount_request mount_requests[MOUNT_REQUESTS_MAX];
+static size_t mount_request_cnt;
+
+/* Requested and actual allocation unit size. */
+size_t filesys_block_size = BLOCK_SECTOR_SIZE;
+size_t fs_cluster_sectors = 1;
+size_t fs_index_sectors = 1;
+
+/* Whether the root file system has a warm-up list. */
+bool fs_warmup;
+
+/* Identifies a superblock. */
+#define SUPER_MAGIC 0x53555052
+
+/* Largest supported cluster, in sectors. */
+#define CLUSTER_SECTORS_MAX 16
+
+/* On-disk superblock in SUPER_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct super_disk
+  {
+    unsigned magic;                     /* SUPER_MAGIC. */
+    uint32_t cluster_sectors;           /* Sectors per cluster. */
+    block_sector_t warmup_sector;       /* WARMUP_SECTOR, or 0 if none. */
+    uint32_t index_sectors;             /* Sectors per index block, or 0
+                                           for 1. */
+    uint32_t unused[124];               /* Not used. */
+  };
+
+static bool read_super (struct block *, size_t *cluster_sectors,
+                        size_t *index_sectors, bool *warmup);
+static void write_super (struct block *);
+static void do_format (struct volume *);
+static void mount_tmpfs (const char *path);
+static void mount_volume (const struct mount_request *, bool format);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
 void
 filesys_init (bool format) 
 {
+  struct volume *root_vol;
+  bool has_super = true;
+  size_t i;
+
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
+  if (format ? filesys_lfs : lfs_detect (fs_device))
+    fs_device = lfs_attach (fs_device, format);
+
+  if (format)
+    {
+      fs_cluster_sectors = filesys_block_size / BLOCK_SECTOR_SIZE;
+      if (filesys_block_size % BLOCK_SECTOR_SIZE != 0
+          || fs_cluster_sectors == 0
+          || fs_cluster_sectors > CLUSTER_SECTORS_MAX
+          || (fs_cluster_sectors & (fs_cluster_sectors - 1)) != 0)
+        PANIC ("block size %zu not supported", filesys_block_size);
+      fs_index_sectors = fs_cluster_sectors;
+    }
+  else
+    has_super = read_super (fs_device, &fs_cluster_sectors,
+                            &fs_index_sectors, &fs_warmup);
 
+  /* Journaled if journal_init() below finds it safe. */
+  root_vol = volume_add (fs_device, false);
   inode_init ();
-  free_map_init ();
+  free_map_init (root_vol);
   cache_init ();
+  dcache_init ();
+  root_vol->journaled = journal_init (format, has_super);
+  tmpfs_init ();
 
   if (format) 
-    do_format ();
+    do_format (root_vol);
+
+  free_map_open (root_vol);
+
+  for (i = 0; i < mount_request_cnt; i++)
+    mount_volume (&mount_requests[i], format);
+  if (filesys_tmpfs != NULL)
+    mount_tmpfs (filesys_tmpfs);
+
+  cache_warmup ();
+}
+
+/* Arranges for filesys_init() to mount the file system on
+   another block device.  SPEC has the form "BDEV:PATH", which
+   mounts the file system on the block device named BDEV over
+   the directory PATH, creating the directory if necessary.
+   With -f, that file system is formatted too. */
+void
+filesys_add_mount (char *spec)
+{
+  char *colon = strchr (spec, ':');
 
-  free_map_open ();
+  if (colon == NULL || colon == spec || colon[1] == '\0')
+    PANIC ("mount: \"%s\" is not BDEV:PATH", spec);
+  if (mount_request_cnt >= MOUNT_REQUESTS_MAX)
+    PANIC ("mount: too many file systems");
+  *colon = '\0';
+  mount_requests[mount_request_cnt].device = spec;
+  mount_requests[mount_request_cnt].path = colon + 1;
+  mount_request_cnt++;
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -38,31 +145,77 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
-  free_map_close ();
+  struct volume *vol;
+  size_t i;
+
+  for (i = 0; (vol = volume_get (i)) != NULL; i++)
+    free_map_close (vol);
   cache_close ();
+  journal_done ();
+  lfs_done ();
 }
 
+/* Allocates an inode for a new file in DIR and stores its inode
+   number into *INUMBER: a free sector on DIR's volume, or a
+   fresh tmpfs inode if DIR is in a tmpfs. */
+static bool
+allocate_inode (struct dir *dir, block_sector_t *inumber)
+{
+  struct volume *vol = dir_get_inode (dir)->vol;
+  block_sector_t sector;
+
+  if (vol == NULL)
+    return tmpfs_allocate (inumber);
+  if (!free_map_allocate (vol, 1, &sector))
+    return false;
+  *inumber = vol->base + sector;
+  return true;
+}
+
+/* Undoes allocate_inode() for INUMBER. */
+static void
+release_inode (block_sector_t inumber)
+{
+  struct volume *vol = volume_of (inumber);
+
+  if (vol == NULL)
+    tmpfs_release (inumber);
+  else
+    free_map_release (vol, inumber - vol->base, 1);
+}
+
 /* Creates a file or directory named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
    or if internal memory allocation fails. */
 bool
 filesys_create (const char *name, off_t initial_size, bool is_dir) 
+{
+  return filesys_create_at (NULL, name, initial_size, is_dir);
+}
+
+/* Like filesys_create(), but a relative NAME is resolved from
+   BASE instead of the current directory if BASE is non-null. */
+bool
+filesys_create_at (struct dir *base, const char *name, off_t initial_size,
+                   bool is_dir) 
 {
   block_sector_t inode_sector = 0;
 
   char directory[strlen(name)+1];
   char file_name[strlen(name)+1];
   get_directory_and_filename(name, directory, file_name);
-  struct dir *dir = dir_open_directory (directory);
+  struct dir *dir = dir_open_directory_at (base, directory);
 
+  journal_begin ();
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  && allocate_inode (dir, &inode_sector)
                   && inode_create (inode_sector, initial_size, is_dir)
                   && dir_add (dir, file_name, inode_sector, is_dir));
 
   if (!success && inode_sector != 0)
-    free_map_release (inode_sector, 1);
+    release_inode (inode_sector);
+  journal_end ();
   dir_close (dir);
 
   return success;
@@ -75,6 +228,14 @@ filesys_create (const char *name, off_t initial_size, bool is_dir)
    or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *name)
+{
+  return filesys_open_at (NULL, name);
+}
+
+/* Like filesys_open(), but a relative NAME is resolved from BASE
+   instead of the current directory if BASE is non-null. */
+struct file *
+filesys_open_at (struct dir *base, const char *name)
 {
   if (strlen(name) == 0) return NULL;
 
@@ -82,7 +243,7 @@ filesys_open (const char *name)
   char file_name[strlen(name)+1];
 
   get_directory_and_filename(name, directory, file_name);
-  struct dir *dir = dir_open_directory (directory);
+  struct dir *dir = dir_open_directory_at (base, directory);
   if (dir == NULL) return NULL;
 
   struct inode *inode = NULL;
@@ -109,12 +270,22 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  char directory[strlen(name)];
-  char file_name[strlen(name)];
+  return filesys_remove_at (NULL, name);
+}
+
+/* Like filesys_remove(), but a relative NAME is resolved from
+   BASE instead of the current directory if BASE is non-null. */
+bool
+filesys_remove_at (struct dir *base, const char *name) 
+{
+  char directory[strlen(name)+1];
+  char file_name[strlen(name)+1];
   get_directory_and_filename (name, directory, file_name);
-  struct dir *dir = dir_open_directory (directory);
+  struct dir *dir = dir_open_directory_at (base, directory);
 
+  journal_begin ();
   bool success = dir != NULL && dir_remove (dir, file_name);
+  journal_end ();
   dir_close (dir);
 
   return success;
@@ -136,14 +307,150 @@ filesys_chdir (const char *name)
   return true;
 }
 
-/* Formats the file system. */
+/* Stores the cluster and index block sizes recorded in DEVICE's
+   superblock into *CLUSTER_SECTORS and *INDEX_SECTORS, and
+   whether it has a warm-up list into *WARMUP.  A file system
+   formatted before superblocks existed has none and uses one
+   sector for each.  Returns true if DEVICE has a superblock. */
+static bool
+read_super (struct block *device, size_t *cluster_sectors,
+            size_t *index_sectors, bool *warmup)
+{
+  struct super_disk super;
+
+  ASSERT (sizeof super == BLOCK_SECTOR_SIZE);
+  block_read (device, SUPER_SECTOR, &super);
+  *warmup = super.magic == SUPER_MAGIC
+            && super.warmup_sector == WARMUP_SECTOR;
+  if (super.magic != SUPER_MAGIC)
+    *cluster_sectors = 1;
+  else if (super.cluster_sectors == 0
+           || super.cluster_sectors > CLUSTER_SECTORS_MAX)
+    PANIC ("bad cluster size in superblock");
+  else
+    *cluster_sectors = super.cluster_sectors;
+  if (super.magic != SUPER_MAGIC || super.index_sectors == 0)
+    *index_sectors = 1;
+  else if (super.index_sectors != *cluster_sectors)
+    PANIC ("bad index block size in superblock");
+  else
+    *index_sectors = super.index_sectors;
+  return super.magic == SUPER_MAGIC;
+}
+
+/* Writes the superblock for the current parameters to DEVICE. */
 static void
-do_format (void)
+write_super (struct block *device)
 {
+  struct super_disk super;
+
+  memset (&super, 0, sizeof super);
+  super.magic = SUPER_MAGIC;
+  super.cluster_sectors = fs_cluster_sectors;
+  super.warmup_sector = WARMUP_SECTOR;
+  super.index_sectors = fs_index_sectors;
+  block_write (device, SUPER_SECTOR, &super);
+}
+
+/* Formats the file system on VOL, whose free map must be
+   initialized but not open. */
+static void
+do_format (struct volume *vol)
+{
+  static const char zeros[BLOCK_SECTOR_SIZE];
+
   printf ("Formatting file system...");
-  free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  write_super (vol->device);
+  block_write (vol->device, WARMUP_SECTOR, zeros);
+  if (vol == volume_get (0))
+    fs_warmup = true;
+  free_map_create (vol);
+  journal_begin ();
+  if (!dir_create (vol->base + ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
-  free_map_close ();
+  journal_end ();
+  free_map_close (vol);
   printf ("done.\n");
 }
+
+/* Mounts the directory whose inode is ROOT_INUMBER over the
+   directory PATH, creating PATH first if it does not exist.
+   WHAT names the kind of file system in error messages. */
+static void
+mount_at (const char *path, block_sector_t root_inumber, const char *what)
+{
+  struct dir *point;
+  struct inode *parent;
+
+  point = dir_open_directory (path);
+  if (point == NULL && filesys_create (path, 0, true))
+    point = dir_open_directory (path);
+  if (point == NULL)
+    PANIC ("%s: can't open or create \"%s\"", what, path);
+  if (inode_get_inumber (dir_get_inode (point)) == ROOT_DIR_SECTOR
+      || !dir_lookup (point, "..", &parent))
+    PANIC ("%s: can't mount over \"%s\"", what, path);
+
+  if (!mount_add (inode_get_inumber (dir_get_inode (point)), root_inumber,
+                  inode_get_inumber (parent)))
+    PANIC ("%s: can't mount over \"%s\"", what, path);
+
+  inode_close (parent);
+  dir_close (point);
+}
+
+/* Mounts a new, empty tmpfs over the directory PATH, creating
+   the directory first if it does not exist. */
+static void
+mount_tmpfs (const char *path)
+{
+  block_sector_t root_inumber;
+
+  if (!tmpfs_allocate (&root_inumber) || !dir_create (root_inumber, 16))
+    PANIC ("tmpfs: root directory creation failed");
+  mount_at (path, root_inumber, "tmpfs");
+}
+
+/* Mounts the file system on the block device named in REQ over
+   the directory it names, formatting it first if FORMAT is
+   true.  The file system must use the root file system's
+   cluster and index block sizes, and it is not journaled. */
+static void
+mount_volume (const struct mount_request *req, bool format)
+{
+  struct block *device = block_get_by_name (req->device);
+  struct volume *vol;
+  size_t cluster_sectors, index_sectors;
+  bool warmup;
+  enum block_type role;
+
+  if (device == NULL)
+    PANIC ("mount: no block device \"%s\"", req->device);
+  for (role = 0; role < BLOCK_ROLE_CNT; role++)
+    if (device == block_get_role (role))
+      PANIC ("mount: %s is already in use", req->device);
+  if (lfs_detect (device))
+    PANIC ("mount: %s: log-structured file systems can only be the root",
+           req->device);
+  if (!format)
+    {
+      read_super (device, &cluster_sectors, &index_sectors, &warmup);
+      if (cluster_sectors != fs_cluster_sectors)
+            PANIC ("mount: %s: cluster size %zu differs from root's %zu",
+               req->device, cluster_sectors * BLOCK_SECTOR_SIZE,
+               FS_CLUSTER_SIZE);
+      if (index_sectors != fs_index_sectors)
+        PANIC ("mount: %s: index block size %zu differs from root's %zu",
+               req->device, index_sectors * BLOCK_SECTOR_SIZE,
+               fs_index_sectors * BLOCK_SECTOR_SIZE);
+    }
+
+  vol = volume_add (device, false);
+  if (vol == NULL)
+    PANIC ("mount: %s: too many or too large file systems", req->device);
+  free_map_init (vol);
+  if (format)
+    do_format (vol);
+  free_map_open (vol);
+  mount_at (req->path, vol->base + ROOT_DIR_SECTOR, "mount");
+}
@@ -2,16 +2,52 @@
 #define FILESYS_FILESYS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
 #include "filesys/off_t.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define SUPER_SECTOR 2          /* File system parameters. */
+#define JOURNAL_SECTOR 3        /* Journal header, log follows. */
+#define WARMUP_SECTOR 132       /* Cache warm-up list, after the log. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* If true, format log-structured (see filesys/lfs.c).
+   Controlled by kernel command-line option "-lfs". */
+extern bool filesys_lfs;
+
+/* If nonnull, a tmpfs is mounted at this path at startup.
+   Controlled by kernel command-line option "-tmpfs=PATH". */
+extern const char *filesys_tmpfs;
+
+/* Allocation unit size in bytes used by do_format(): 512, 1024,
+   2048, 4096 or 8192.  Controlled by kernel command-line option
+   "-blocksize=BYTES". */
+extern size_t filesys_block_size;
+
+/* Sectors per cluster, the unit in which the free map allocates
+   and in which inodes map file data.  Clusters are aligned, so
+   cluster N spans sectors N * fs_cluster_sectors and up. */
+extern size_t fs_cluster_sectors;
+
+/* Sectors per inode index block: fs_cluster_sectors, or 1 in
+   file systems formatted before index blocks filled their
+   cluster. */
+extern size_t fs_index_sectors;
+
+/* True if the root file system reserves WARMUP_SECTOR.  File
+   systems formatted before it existed may have data there. */
+extern bool fs_warmup;
+
+/* Bytes per cluster. */
+#define FS_CLUSTER_SIZE (fs_cluster_sectors * BLOCK_SECTOR_SIZE)
+
 void filesys_init (bool format);
+void filesys_add_mount (char *spec);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size, bool is_dir);
 bool filesys_remove (const char *name);
@@ -19,4 +55,10 @@ bool filesys_chdir (const char *name);
 
 struct file *filesys_open (const char *name);
 
+struct dir;
+bool filesys_create_at (struct dir *, const char *name, off_t initial_size,
+                        bool is_dir);
+bool filesys_remove_at (struct dir *, const char *name);
+struct file *filesys_open_at (struct dir *, const char *name);
+
 #endif /* filesys/filesys.h */
@@ -1,85 +1,172 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
+#include "filesys/tmpfs.h"
+#include "threads/synch.h"
 
-static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per sector. */
+/* Each volume has its own free map, one bit per cluster, kept
+   in the free map file whose inode is at FREE_MAP_SECTOR on that
+   volume.  Sectors here are local to the volume. */
 
-/* Initializes the free map. */
+/* Fewest clusters a volume can have: enough for the fixed
+   sectors below. */
+#define MIN_CLUSTERS DIV_ROUND_UP (WARMUP_SECTOR + 1, fs_cluster_sectors)
+
+/* Initializes the free map of VOL, and with it VOL's size.  A
+   device may be too large for all of it to be used, either
+   because the inode numbers after VOL's base run out or because
+   a free map for all of it can't be allocated.  Then only as
+   much of it as fits is used. */
 void
-free_map_init (void) 
+free_map_init (struct volume *vol) 
 {
-  free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
-    PANIC ("bitmap creation failed--file system device is too large");
-  bitmap_mark (free_map, FREE_MAP_SECTOR);
-  bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  block_sector_t sectors = block_size (vol->device);
+  size_t clusters;
+
+  if (sectors > TMPFS_INUMBER_BIT - vol->base)
+    sectors = TMPFS_INUMBER_BIT - vol->base;
+  clusters = sectors / fs_cluster_sectors;
+  while ((vol->free_map = bitmap_create (clusters)) == NULL
+         && clusters / 2 >= MIN_CLUSTERS)
+    clusters /= 2;
+  if (vol->free_map == NULL || clusters < MIN_CLUSTERS)
+    PANIC ("%s: can't set up a free map", block_name (vol->device));
+  vol->size = clusters * fs_cluster_sectors;
+  if (vol->size < block_size (vol->device))
+    printf ("%s: using only the first %"PRDSNu" sectors\n",
+            block_name (vol->device), vol->size);
+
+  /* The system inodes, superblock, journal, and warm-up list are
+     at fixed sectors; reserve every cluster they touch. */
+  ASSERT (WARMUP_SECTOR == JOURNAL_SECTOR + 1 + JOURNAL_SECTORS);
+  bitmap_set_multiple (vol->free_map, 0, MIN_CLUSTERS, true);
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+/* Allocates CNT consecutive clusters from the free map of VOL
+   and stores the first sector of the first one into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   clusters were available or if the free_map file could not be
+   written.  Only the free map sectors whose bits change are
+   written, so that each one is journaled only when it has to
+   be. */
 bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+free_map_allocate (struct volume *vol, size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  size_t cluster;
+
+  /* Writing the map opens a journal handle, which has to come
+     before free_map_lock. */
+  journal_begin ();
+  lock_acquire (&vol->free_map_lock);
+  cluster = bitmap_scan_and_flip (vol->free_map, 0, cnt, false);
+  if (cluster != BITMAP_ERROR
+      && vol->free_map_file != NULL
+      && !bitmap_write_range (vol->free_map, vol->free_map_file,
+                              cluster, cnt))
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (vol->free_map, cluster, cnt, false); 
+      cluster = BITMAP_ERROR;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  lock_release (&vol->free_map_lock);
+  journal_end ();
+  if (cluster != BITMAP_ERROR)
+    *sectorp = cluster * fs_cluster_sectors;
+  return cluster != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT clusters of VOL starting at SECTOR, which must
+   begin a cluster, available for use. */
 void
-free_map_release (block_sector_t sector, size_t cnt)
+free_map_release (struct volume *vol, block_sector_t sector, size_t cnt)
 {
-  ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  size_t cluster = sector / fs_cluster_sectors;
+  size_t i;
+
+  ASSERT (sector % fs_cluster_sectors == 0);
+  journal_begin ();
+  if (vol->journaled)
+    for (i = 0; i < cnt * fs_cluster_sectors; i++)
+      journal_forget (vol->base + sector + i);
+
+  lock_acquire (&vol->free_map_lock);
+  ASSERT (bitmap_all (vol->free_map, cluster, cnt));
+  bitmap_set_multiple (vol->free_map, cluster, cnt, false);
+  bitmap_write_range (vol->free_map, vol->free_map_file, cluster, cnt);
+  lock_release (&vol->free_map_lock);
+  journal_end ();
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Opens the free map file of VOL and reads it from disk.  If the
+   file system was formatted to use less of the device than
+   free_map_init() allowed for, VOL shrinks to match. */
 void
-free_map_open (void) 
+free_map_open (struct volume *vol) 
 {
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  size_t clusters;
+
+  vol->free_map_file = file_open (inode_open (vol->base + FREE_MAP_SECTOR));
+  if (vol->free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_read (free_map, free_map_file))
+  clusters = file_length (vol->free_map_file) * 8;
+  if (clusters < bitmap_size (vol->free_map))
+    {
+      bitmap_destroy (vol->free_map);
+      vol->free_map = bitmap_create (clusters);
+      if (vol->free_map == NULL)
+        PANIC ("can't allocate free map");
+      vol->size = clusters * fs_cluster_sectors;
+    }
+  if (!bitmap_read (vol->free_map, vol->free_map_file))
     PANIC ("can't read free map");
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Writes the free map of VOL to disk and closes the free map
+   file. */
 void
-free_map_close (void) 
+free_map_close (struct volume *vol) 
 {
-  file_close (free_map_file);
+  file_close (vol->free_map_file);
+  vol->free_map_file = NULL;
 }
 
-/* Creates a new free map file on disk and writes the free map to
-   it. */
+/* Creates a new free map file on VOL and writes the free map to
+   it.  Must be called outside any journal handle, because the
+   map is written a sector at a time, each in its own handle, so
+   that a map bigger than the log still gets journaled. */
 void
-free_map_create (void) 
+free_map_create (struct volume *vol) 
 {
+  size_t bit_cnt = bitmap_size (vol->free_map);
+  size_t start;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
+  if (!inode_create (vol->base + FREE_MAP_SECTOR,
+                     bitmap_file_size (vol->free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  vol->free_map_file = file_open (inode_open (vol->base + FREE_MAP_SECTOR));
+  if (vol->free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
-    PANIC ("can't write free map");
+  for (start = 0; start < bit_cnt; start += BLOCK_SECTOR_SIZE * 8)
+    {
+      size_t cnt = bit_cnt - start;
+      bool ok;
+
+      if (cnt > BLOCK_SECTOR_SIZE * 8)
+        cnt = BLOCK_SECTOR_SIZE * 8;
+      journal_begin ();
+      ok = bitmap_write_range (vol->free_map, vol->free_map_file,
+                               start, cnt);
+      journal_end ();
+      if (!ok)
+        PANIC ("can't write free map");
+    }
 }
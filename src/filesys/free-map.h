@@ -5,13 +5,14 @@
 #include <stddef.h>
 #include "devices/block.h"
 
-void free_map_init (void);
-void free_map_read (void);
-void free_map_create (void);
-void free_map_open (void);
-void free_map_close (void);
+struct volume;
 
-bool free_map_allocate (size_t, block_sector_t *);
-void free_map_release (block_sector_t, size_t);
+void free_map_init (struct volume *);
+void free_map_create (struct volume *);
+void free_map_open (struct volume *);
+void free_map_close (struct volume *);
+
+bool free_map_allocate (struct volume *, size_t, block_sector_t *);
+void free_map_release (struct volume *, block_sector_t, size_t);
 
 #endif /* filesys/free-map.h */
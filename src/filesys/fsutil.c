@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +8,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -221,3 +223,28 @@ fsutil_append (char **argv)
   file_close (src);
   free (buffer);
 }
+
+/* Moves the data of file ARGV[1] into one contiguous run and
+   reports how fragmented it was. */
+void
+fsutil_defrag (char **argv) 
+{
+  const char *file_name = argv[1];
+  struct defrag_stats stats;
+  struct file *file;
+  bool success;
+
+  printf ("Defragmenting '%s'...\n", file_name);
+  file = filesys_open (file_name);
+  if (file == NULL)
+    PANIC ("%s: open failed", file_name);
+  success = inode_defrag (file_get_inode (file), &stats);
+  file_close (file);
+
+  printf ("%s: %"PRId32" clusters in %"PRId32" extents, now %"PRId32".\n",
+          file_name, stats.clusters, stats.extents_before,
+          stats.extents_after);
+  if (!success)
+    printf ("%s: no contiguous run of free clusters is long enough\n",
+            file_name);
+}
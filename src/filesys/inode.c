@@ -3,25 +3,74 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "devices/iotrace.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
 #include "filesys/cache.h"
 
-static bool inode_allocate(struct inode_disk *disk_inode);
+static bool inode_allocate(struct volume *vol, struct inode_disk *disk_inode);
 
 static bool inode_deallocate(struct inode *inode);
 
-static bool inode_keep(struct inode_disk *disk_inode, off_t length);
+static bool inode_keep(struct volume *vol, struct inode_disk *disk_inode, off_t length, block_sector_t *run);
 
-static bool inode_keep_indirect(block_sector_t *p_entry, size_t num_sectors, int level);
+static bool inode_keep_indirect(struct volume *vol, block_sector_t *p_entry, size_t num_sectors, int level, block_sector_t *run);
 
-/* Returns the number of sectors to allocate for an inode SIZE
+static void inode_shrink(struct volume *vol, struct inode_disk *disk_inode, size_t new_sectors, size_t old_sectors);
+
+static block_sector_t sector_entry(const struct volume *vol, const struct inode_disk *idisk, off_t index);
+
+static void set_index(const struct volume *vol, struct inode_disk *idisk, size_t index,
+                      block_sector_t sector, bool unwritten);
+
+/* Set in a data cluster pointer if the cluster was preallocated
+   by inode_fallocate() and never written.  It reads as zeros
+   whatever the disk holds, and the first write zeroes it and
+   clears the bit.  Local sectors never reach bit 31. */
+#define UNWRITTEN_BIT 0x80000000u
+
+/* Returns the sector a data cluster pointer refers to. */
+#define ENTRY_SECTOR(ENTRY) ((ENTRY) & ~UNWRITTEN_BIT)
+
+/* Pointers per index block.  An index block fills its cluster,
+   so each level reaches further as clusters grow. */
+#define INDEX_PTRS (fs_index_sectors * INDIRECT_BLOCKS_PER_SECTOR)
+
+/* Returns pointer I of the index block at local sector BLOCK of
+   VOL. */
+static block_sector_t
+index_get(const struct volume *vol, block_sector_t block, size_t i)
+{
+  struct inode_indirect_block_sector sector;
+
+  cache_read_meta(vol->base + block + i / INDIRECT_BLOCKS_PER_SECTOR, &sector);
+  return sector.blocks[i % INDIRECT_BLOCKS_PER_SECTOR];
+}
+
+/* Sets pointer I of the index block at local sector BLOCK of VOL
+   to ENTRY, through the journal. */
+static void
+index_set(const struct volume *vol, block_sector_t block, size_t i,
+          block_sector_t entry)
+{
+  struct inode_indirect_block_sector sector;
+  block_sector_t s = vol->base + block + i / INDIRECT_BLOCKS_PER_SECTOR;
+
+  cache_read_meta(s, &sector);
+  sector.blocks[i % INDIRECT_BLOCKS_PER_SECTOR] = entry;
+  cache_write_meta(s, &sector);
+}
+
+/* Returns the number of clusters to allocate for an inode SIZE
    bytes long. */
 static inline size_t
-bytes_to_sectors(off_t size)
+bytes_to_clusters(off_t size)
 {
-  return DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE);
+  return DIV_ROUND_UP(size, FS_CLUSTER_SIZE);
 }
 
 static inline size_t
@@ -37,97 +86,137 @@ minest(size_t a, size_t b)
   
 }
 
+/* Returns the first sector of data cluster INDEX of IDISK, an
+   inode on VOL, as an inode number of VOL.  The pointers on disk
+   are local to VOL.  If UNWRITTEN is nonnull, stores into it
+   whether the cluster has never been written. */
 static block_sector_t
-sector_to_index(const struct inode_disk *idisk, off_t index)
+sector_to_index(const struct volume *vol, const struct inode_disk *idisk, off_t index,
+                bool *unwritten)
 {
-  off_t base = 0;
-
-  off_t limit = 0; 
+  block_sector_t entry = sector_entry(vol, idisk, index);
 
-  block_sector_t sector_setter;
-
-  
-  limit = limit +  DIRECT_BLOCKS_COUNT ;
+  if (unwritten != NULL)
+    *unwritten = (entry & UNWRITTEN_BIT) != 0;
+  return vol->base + ENTRY_SECTOR(entry);
+}
 
-  if (index < limit)
-  {
+/* Returns the pointer to data cluster INDEX of IDISK, an inode
+   on VOL, as stored on disk. */
+static block_sector_t
+sector_entry(const struct volume *vol, const struct inode_disk *idisk, off_t index)
+{
+  if (index < DIRECT_BLOCKS_COUNT)
     return idisk->direct_blocks[index];
-  }
+  index -= DIRECT_BLOCKS_COUNT;
 
-  base = limit;
+  if ((size_t) index < INDEX_PTRS)
+    return index_get(vol, idisk->indirect_block, index);
+  index -= INDEX_PTRS;
 
+  if ((size_t) index < INDEX_PTRS * INDEX_PTRS)
+    return index_get(vol, index_get(vol, idisk->doubly_indirect_block,
+                                    index / INDEX_PTRS),
+                     index % INDEX_PTRS);
 
-
-  limit = limit +  INDIRECT_BLOCKS_PER_SECTOR;
-  if (index < limit)
-  {
-    struct inode_indirect_block_sector *indirect_idisk;
-
-    indirect_idisk = calloc(1, sizeof(struct inode_indirect_block_sector));
-
-    cache_read(idisk->indirect_block, indirect_idisk);
-
-    sector_setter = indirect_idisk->blocks[index - base];
-
-    free(indirect_idisk);
-
-    return sector_setter;
-  }
-
-  base = limit;
-  
-
-  limit = limit + INDIRECT_BLOCKS_PER_SECTOR * INDIRECT_BLOCKS_PER_SECTOR;
-  if (index < limit)
-  {
- 
-    off_t first = (index - base) / INDIRECT_BLOCKS_PER_SECTOR;
-    off_t second = (index - base) % INDIRECT_BLOCKS_PER_SECTOR;
-
-   
-    struct inode_indirect_block_sector *indirect_idisk;
-    indirect_idisk = calloc(1, sizeof(struct inode_indirect_block_sector));
-
-    cache_read(idisk->doubly_indirect_block, indirect_idisk);
-    cache_read(indirect_idisk->blocks[first], indirect_idisk);
-    sector_setter = indirect_idisk->blocks[second];
-
-    free(indirect_idisk);
-    return sector_setter;
-  }
-
- 
   return -1;
 }
 
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS.  If UNWRITTEN is nonnull, stores into it whether POS is
+   in a preallocated cluster that reads as zeros. */
 static block_sector_t
-byte_to_sector(const struct inode *inode, off_t pos)
+byte_to_sector(const struct inode *inode, off_t pos, bool *unwritten)
 {
   ASSERT(inode != NULL);
+  if (unwritten != NULL)
+    *unwritten = false;
   //   if (pos < inode->data.length)
   //     return inode->data.start + pos / BLOCK_SECTOR_SIZE;
   if (0 <= pos && pos < inode->data.length)
   {
-    // sector index
-    off_t index = pos / BLOCK_SECTOR_SIZE;
-    return sector_to_index(&inode->data, index);
+    // cluster index, then the sector within that cluster
+    off_t index = pos / FS_CLUSTER_SIZE;
+    return sector_to_index(inode->vol, &inode->data, index, unwritten)
+           + pos % FS_CLUSTER_SIZE / BLOCK_SECTOR_SIZE;
   }
   else
     return -1;
 }
 
+/* Fills the freshly allocated data cluster that starts at
+   SECTOR with zeros. */
+static void
+zero_cluster(block_sector_t sector)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  for (i = 0; i < fs_cluster_sectors; i++)
+    cache_write(sector + i, zeros);
+}
+
+/* Returns true if INODE's contents are metadata: a directory or
+   a free map. */
+static bool
+is_meta(const struct inode *inode)
+{
+  return (inode->data.is_dir
+          || (inode->vol != NULL
+              && inode->sector == inode->vol->base + FREE_MAP_SECTOR));
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER to SECTOR of
+   INODE's contents.  Directories and the free map are metadata,
+   so their contents go through the journal. */
+static void
+write_content(const struct inode *inode, block_sector_t sector, void *buffer)
+{
+  if (is_meta(inode))
+    cache_write_meta(sector, buffer);
+  else
+    cache_write(sector, buffer);
+}
+
+/* Zeroes data cluster INDEX of INODE, which starts at SECTOR
+   and is unwritten, and marks it written.  Must be called
+   within a journal handle, before writing to the cluster.
+
+   The zeros go straight to disk before the bit is cleared, and
+   the journal flushes the disk before it commits the clear.
+   Zeros left in the cache could still be unwritten when the
+   journal commits, and after a crash the cluster would show
+   whatever it held before it was preallocated. */
+static void
+write_unwritten(struct inode *inode, size_t index, block_sector_t sector)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  for (i = 0; i < fs_cluster_sectors; i++)
+    cache_write_direct(sector + i, zeros);
+  set_index(inode->vol, &inode->data, index, sector, false);
+  cache_write_meta(inode->sector, &inode->data);
+}
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes and every inode's open_cnt and loading. */
+static struct lock open_inodes_lock;
+
+/* Signaled when an inode in open_inodes finishes loading. */
+static struct condition inode_loaded;
+
 /* Initializes the inode module. */
 void inode_init(void)
 {
   list_init(&open_inodes);
+  lock_init(&open_inodes_lock);
+  cond_init(&inode_loaded);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -142,6 +231,9 @@ bool inode_create(block_sector_t sector, off_t length, bool is_dir)
 
   ASSERT(length >= 0);
 
+  if (tmpfs_owns(sector))
+    return tmpfs_setup(sector, length, is_dir);
+
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
   ASSERT(sizeof *disk_inode == BLOCK_SECTOR_SIZE);
@@ -153,10 +245,10 @@ bool inode_create(block_sector_t sector, off_t length, bool is_dir)
     disk_inode->length = length;
     disk_inode->magic = INODE_MAGIC;
     disk_inode->is_dir = is_dir;
-    if (inode_allocate(disk_inode))
+    if (inode_allocate(volume_of(sector), disk_inode))
     {
       /* Our implementation: cache write */
-      cache_write(sector, disk_inode);
+      cache_write_meta(sector, disk_inode);
       // block_write (fs_device, sector, disk_inode);
       //           if (sectors > 0)
       //             {
@@ -177,13 +269,18 @@ bool inode_create(block_sector_t sector, off_t length, bool is_dir)
 
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
+   Returns a null pointer if memory allocation fails.
+   The inode is listed as loading while it is read, so that
+   open_inodes_lock isn't held across the read; anyone else
+   opening it meanwhile waits for the read to finish. */
 struct inode *
 inode_open(block_sector_t sector)
 {
   struct list_elem *e;
   struct inode *inode;
 
+  lock_acquire(&open_inodes_lock);
+
   /* Check whether this inode is already open. */
   for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
        e = list_next(e))
@@ -191,15 +288,24 @@ inode_open(block_sector_t sector)
     inode = list_entry(e, struct inode, elem);
     if (inode->sector == sector)
     {
-      inode_reopen(inode);
+      inode->open_cnt++;
+      while (inode->loading)
+        cond_wait(&inode_loaded, &open_inodes_lock);
+      lock_release(&open_inodes_lock);
       return inode;
     }
   }
 
   /* Allocate memory. */
+  struct tmpfs_node *node = NULL;
   inode = malloc(sizeof *inode);
-  if (inode == NULL)
+  if (inode == NULL
+      || (tmpfs_owns(sector) && (node = tmpfs_lookup(sector)) == NULL))
+  {
+    free(inode);
+    lock_release(&open_inodes_lock);
     return NULL;
+  }
 
   /* Initialize. */
   list_push_front(&open_inodes, &inode->elem);
@@ -207,9 +313,33 @@ inode_open(block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  /* Our implementation: cache read */
-  cache_read(inode->sector, &inode->data);
-  // block_read (fs_device, inode->sector, &inode->data);
+  inode->dir_free_ofs = 0;
+  inode->dir_entry_cnt = -1;
+  inode->write_gen = 0;
+  lock_init(&inode->dir_lock);
+  inode->tmpfs = node;
+  inode->vol = volume_of(sector);
+  inode->loading = node == NULL;
+  if (node != NULL)
+  {
+    // tmpfs inodes have no sector; keep the fields others look at
+    memset(&inode->data, 0, sizeof inode->data);
+    inode->data.is_dir = tmpfs_is_dir(node);
+    inode->data.length = tmpfs_length(node);
+    inode->data.magic = INODE_MAGIC;
+  }
+  lock_release(&open_inodes_lock);
+
+  if (inode->loading)
+  {
+    /* Our implementation: cache read */
+    cache_read_meta(inode->sector, &inode->data);
+    // block_read (fs_device, inode->sector, &inode->data);
+    lock_acquire(&open_inodes_lock);
+    inode->loading = false;
+    cond_broadcast(&inode_loaded, &open_inodes_lock);
+    lock_release(&open_inodes_lock);
+  }
   return inode;
 }
 
@@ -218,7 +348,11 @@ struct inode *
 inode_reopen(struct inode *inode)
 {
   if (inode != NULL)
+  {
+    lock_acquire(&open_inodes_lock);
     inode->open_cnt++;
+    lock_release(&open_inodes_lock);
+  }
   return inode;
 }
 
@@ -239,22 +373,32 @@ void inode_close(struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire(&open_inodes_lock);
+  if (--inode->open_cnt > 0)
   {
-    /* Remove from inode list and release lock. */
-    list_remove(&inode->elem);
+    lock_release(&open_inodes_lock);
+    return;
+  }
 
-    /* Deallocate blocks if removed. */
-    if (inode->removed)
-    {
-      free_map_release(inode->sector, 1);
-      //           free_map_release (inode->data.start,
-      //                             bytes_to_sectors (inode->data.length));
-      inode_deallocate(inode);
-    }
+  /* Remove from inode list and release lock.  The journal handle
+     below must not be started with open_inodes_lock held. */
+  list_remove(&inode->elem);
+  lock_release(&open_inodes_lock);
 
-    free(inode);
+  /* Deallocate blocks if removed. */
+  if (inode->removed && inode->tmpfs != NULL)
+    tmpfs_release(inode->sector);
+  else if (inode->removed)
+  {
+    journal_begin();
+    free_map_release(inode->vol, inode->sector - inode->vol->base, 1);
+    //           free_map_release (inode->data.start,
+    //                             bytes_to_sectors (inode->data.length));
+    inode_deallocate(inode);
+    journal_end();
   }
+
+  free(inode);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -266,18 +410,28 @@ void inode_remove(struct inode *inode)
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Whole sectors bypass the buffer cache if DIRECT is true.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
-off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
+static off_t
+read_at(struct inode *inode, void *buffer_, off_t size, off_t offset,
+        bool direct)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
+  // directory and free map reads are metadata lookups
+  void (*read_sector)(block_sector_t, void *)
+      = is_meta(inode) ? cache_read_meta : cache_read;
+
+  if (inode->tmpfs != NULL)
+    return tmpfs_read(inode->tmpfs, buffer_, size, offset);
 
   while (size > 0)
   {
     /* Disk sector to read, starting byte offset within sector. */
-    block_sector_t sector_idx = byte_to_sector(inode, offset);
+    bool unwritten;
+    block_sector_t sector_idx = byte_to_sector(inode, offset, &unwritten);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -290,11 +444,13 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
     if (chunk_size <= 0)
       break;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+    if (unwritten)
+      memset(buffer + bytes_read, 0, chunk_size);
+    else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE && !direct)
     {
       /* Read full sector directly into caller's buffer. */
       /* Our implementation: cache read */
-      cache_read(sector_idx, buffer + bytes_read);
+      read_sector(sector_idx, buffer + bytes_read);
       // block_read (fs_device, sector_idx, buffer + bytes_read);
     }
     else
@@ -307,8 +463,14 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
         if (bounce == NULL)
           break;
       }
-      /* Our implementation: cache read */
-      cache_read(sector_idx, bounce);
+      /* Our implementation: cache read.  Direct reads come through
+         the bounce buffer too, since BUFFER may be in user memory,
+         which the device can't reach by DMA or from its dispatcher
+         thread. */
+      if (direct)
+        cache_read_direct(sector_idx, bounce);
+      else
+        read_sector(sector_idx, bounce);
       // block_read (fs_device, sector_idx, bounce);
       memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
     }
@@ -323,13 +485,36 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
   return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached. */
+off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
+{
+  block_sector_t traced = iotrace_set_inode(inode->sector);
+  off_t bytes_read = read_at(inode, buffer_, size, offset, false);
+  iotrace_set_inode(traced);
+  return bytes_read;
+}
+
+/* Like inode_read_at(), but sector-aligned parts of the read
+   go straight from the device unless the sector is cached. */
+off_t inode_read_direct_at(struct inode *inode, void *buffer_, off_t size,
+                           off_t offset)
+{
+  block_sector_t traced = iotrace_set_inode(inode->sector);
+  off_t bytes_read = read_at(inode, buffer_, size, offset, true);
+  iotrace_set_inode(traced);
+  return bytes_read;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
-                     off_t offset)
+   Whole sectors of a file's data bypass the buffer cache if
+   DIRECT is true. */
+static off_t
+write_at(struct inode *inode, const void *buffer_, off_t size, off_t offset,
+         bool direct)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
@@ -338,22 +523,35 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
-  if (byte_to_sector(inode, offset + size - 1) == -1u)
+  if (inode->tmpfs != NULL)
+  {
+    bytes_written = tmpfs_write(inode->tmpfs, buffer_, size, offset);
+    inode->data.length = tmpfs_length(inode->tmpfs);
+    return bytes_written;
+  }
+
+  journal_begin();
+  if (byte_to_sector(inode, offset + size - 1, NULL) == -1u)
   {
 
     bool success;
-    success = inode_keep(&inode->data, offset + size);
+    success = inode_keep(inode->vol, &inode->data, offset + size, NULL);
     if (!success)
+    {
+      inode->write_gen++;
+      journal_end();
       return 0; 
+    }
 
     inode->data.length = offset + size;
-    cache_write(inode->sector, &inode->data);
+    cache_write_meta(inode->sector, &inode->data);
   }
 
   while (size > 0)
   {
     /* Sector to write, starting byte offset within sector. */
-    block_sector_t sector_idx = byte_to_sector(inode, offset);
+    bool unwritten;
+    block_sector_t sector_idx = byte_to_sector(inode, offset, &unwritten);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -366,12 +564,18 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
     if (chunk_size <= 0)
       break;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+    // a preallocated cluster turns into zeros on its first write
+    if (unwritten)
+      write_unwritten(inode, offset / FS_CLUSTER_SIZE,
+                      sector_idx - sector_idx % fs_cluster_sectors);
+
+    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE
+        && !(direct && !is_meta(inode)))
     {
       /* Write full sector directly to disk. */
       // block_write (fs_device, sector_idx, buffer + bytes_written);
       /* Our implementation: cache write */
-      cache_write(sector_idx, buffer + bytes_written);
+      write_content(inode, sector_idx, (void *) (buffer + bytes_written));
     }
     else
     {
@@ -394,8 +598,13 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
         memset(bounce, 0, BLOCK_SECTOR_SIZE);
       memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
       // block_write (fs_device, sector_idx, bounce);
-      /* Our implementation: cache write */
-      cache_write(sector_idx, bounce);
+      /* Our implementation: cache write.  A direct write of a whole
+         sector lands here too, so that the device gets a kernel
+         buffer rather than BUFFER, which may be in user memory. */
+      if (direct && !is_meta(inode) && chunk_size == BLOCK_SECTOR_SIZE)
+        cache_write_direct(sector_idx, bounce);
+      else
+        write_content(inode, sector_idx, bounce);
     }
 
     /* Advance. */
@@ -404,10 +613,77 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
     bytes_written += chunk_size;
   }
   free(bounce);
+  // only now, so that inode_defrag() can't miss a write in progress
+  inode->write_gen++;
+  journal_end();
 
   return bytes_written;
 }
 
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if an error occurs. */
+off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
+                     off_t offset)
+{
+  block_sector_t traced = iotrace_set_inode(inode->sector);
+  off_t bytes_written = write_at(inode, buffer_, size, offset, false);
+  iotrace_set_inode(traced);
+  return bytes_written;
+}
+
+/* Like inode_write_at(), but sector-aligned parts of a file's
+   data go straight to the device, updating any cached copy. */
+off_t inode_write_direct_at(struct inode *inode, const void *buffer_,
+                            off_t size, off_t offset)
+{
+  block_sector_t traced = iotrace_set_inode(inode->sector);
+  off_t bytes_written = write_at(inode, buffer_, size, offset, true);
+  iotrace_set_inode(traced);
+  return bytes_written;
+}
+
+/* Shrinks INODE to LENGTH bytes, which must not exceed its
+   current length, and releases the clusters past the new end. */
+void inode_truncate(struct inode *inode, off_t length)
+{
+  off_t pos = length;
+  off_t end = ROUND_UP(length, FS_CLUSTER_SIZE);
+
+  ASSERT(length >= 0 && length <= inode_length(inode));
+
+  if (inode->tmpfs != NULL)
+  {
+    tmpfs_truncate(inode->tmpfs, length);
+    inode->data.length = length;
+    return;
+  }
+
+  /* Clear the rest of the last cluster so that growing the inode
+     again reads zeros rather than stale bytes. */
+  if (end > inode_length(inode))
+    end = inode_length(inode);
+  while (pos < end)
+  {
+    bool unwritten;
+    block_sector_t sector_idx = byte_to_sector(inode, pos, &unwritten);
+    int sector_ofs = pos % BLOCK_SECTOR_SIZE;
+    char buffer[BLOCK_SECTOR_SIZE];
+    if (unwritten)
+      break;
+    if (sector_ofs > 0)
+      cache_read(sector_idx, buffer);
+    memset(buffer + sector_ofs, 0, BLOCK_SECTOR_SIZE - sector_ofs);
+    write_content(inode, sector_idx, buffer);
+    pos += BLOCK_SECTOR_SIZE - sector_ofs;
+  }
+
+  inode_shrink(inode->vol, &inode->data, bytes_to_clusters(length),
+               bytes_to_clusters(inode->data.length));
+  inode->data.length = length;
+  cache_write_meta(inode->sector, &inode->data);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode *inode)
@@ -432,13 +708,139 @@ off_t inode_length(const struct inode *inode)
   return inode->data.length;
 }
 
-static bool inode_allocate(struct inode_disk *disk_inode)
+/* Grows INODE, an ordinary file, to at least LENGTH bytes.  The
+   new clusters come from one run of contiguous free clusters and
+   read as zeros without being written, so later writes into them
+   allocate nothing.  Returns true if successful, false if INODE
+   is a directory or no run of free clusters is long enough. */
+bool inode_fallocate(struct inode *inode, off_t length)
+{
+  size_t old_cnt, new_cnt;
+  block_sector_t run = 0, run_end;
+  bool success;
+
+  if (length <= inode->data.length)
+    return true;
+  if (inode->tmpfs != NULL)
+  {
+    success = tmpfs_extend(inode->tmpfs, length);
+    inode->data.length = tmpfs_length(inode->tmpfs);
+    return success;
+  }
+  if (is_meta(inode))
+    return false;
+
+  old_cnt = bytes_to_clusters(inode->data.length);
+  new_cnt = bytes_to_clusters(length);
+  journal_begin();
+  if (new_cnt > old_cnt && !free_map_allocate(inode->vol, new_cnt - old_cnt, &run))
+  {
+    journal_end();
+    return false;
+  }
+  run_end = run + (new_cnt - old_cnt) * fs_cluster_sectors;
+
+  success = inode_keep(inode->vol, &inode->data, length, &run);
+  if (success)
+  {
+    inode->data.length = length;
+    cache_write_meta(inode->sector, &inode->data);
+    inode->write_gen++;
+  }
+  else if (run < run_end)
+  {
+    // index blocks ran out; give back the part of the run not taken
+    free_map_release(inode->vol, run, (run_end - run) / fs_cluster_sectors);
+  }
+  journal_end();
+  return success;
+}
+
+/* Calls FN on the first sector of each of INODE's data clusters
+   that lies in the LENGTH bytes at OFFSET, stopping at end of
+   file.  If WHOLE, a cluster only partly in the range is
+   skipped unless the range runs to end of file. */
+static void
+for_each_cluster(struct inode *inode, off_t offset, off_t length, bool whole,
+                 void (*fn)(block_sector_t))
+{
+  off_t end = inode->data.length;
+  off_t first, last, i;
+
+  if (inode->tmpfs != NULL || offset < 0 || length <= 0 || offset >= end)
+    return;
+  if (length < end - offset)
+    end = offset + length;
+
+  first = offset / FS_CLUSTER_SIZE;
+  last = DIV_ROUND_UP(end, FS_CLUSTER_SIZE);
+  if (whole)
+  {
+    first = DIV_ROUND_UP(offset, FS_CLUSTER_SIZE);
+    if (end < inode->data.length)
+      last = end / FS_CLUSTER_SIZE;
+  }
+  for (i = first; i < last; i++)
+  {
+    bool unwritten;
+    block_sector_t sector = byte_to_sector(inode, i * FS_CLUSTER_SIZE, &unwritten);
+    if (!unwritten)
+      fn(sector);
+  }
+}
+
+/* Starts reading the data of INODE in the LENGTH bytes at OFFSET
+   into the buffer cache in the background. */
+void inode_prefetch(struct inode *inode, off_t offset, off_t length)
+{
+  for_each_cluster(inode, offset, length, false, cache_prefetch);
+}
+
+/* Drops the clean cached data of INODE that lies wholly in the
+   LENGTH bytes at OFFSET. */
+void inode_discard(struct inode *inode, off_t offset, off_t length)
+{
+  for_each_cluster(inode, offset, length, true, cache_discard);
+}
+
+/* Makes the cached data of INODE that lies wholly in the LENGTH
+   bytes at OFFSET the first to be evicted. */
+void inode_demote(struct inode *inode, off_t offset, off_t length)
+{
+  for_each_cluster(inode, offset, length, true, cache_demote);
+}
+
+/* Writes the cached data of INODE back to its device and waits
+   for the device to finish.  Its metadata is the journal's to
+   commit, except on a volume without a journal, where it can be
+   anywhere in the cache, so the whole cache is written back. */
+void inode_sync(struct inode *inode)
+{
+  if (inode->tmpfs != NULL)
+    return;
+  if (!inode->vol->journaled)
+  {
+    cache_flush();
+    return;
+  }
+  for_each_cluster(inode, 0, inode->data.length, false, cache_sync);
+  block_flush(inode->vol->device);
+}
+
+static bool inode_allocate(struct volume *vol, struct inode_disk *disk_inode)
 {
-  return inode_keep(disk_inode, disk_inode->length);
+  return inode_keep(vol, disk_inode, disk_inode->length, NULL);
 }
 
+/* Makes sure the index block or data cluster *P_ENTRY, local to
+   VOL, exists and covers NUM_SECTORS data clusters below it.
+   If RUN is nonnull, missing data clusters are taken from the
+   free clusters starting at *RUN, which advances, and marked
+   unwritten instead of being zeroed.  An index block spans
+   fs_index_sectors sectors, handled one at a time. */
 static bool
-inode_keep_indirect(block_sector_t *p_entry, size_t num_sectors, int level)
+inode_keep_indirect(struct volume *vol, block_sector_t *p_entry, size_t num_sectors, int level,
+                    block_sector_t *run)
 {
   static char zeros[BLOCK_SECTOR_SIZE];
 
@@ -447,12 +849,17 @@ inode_keep_indirect(block_sector_t *p_entry, size_t num_sectors, int level)
   if (level == 0)
   {
 
-    if (*p_entry == 0)
+    if (*p_entry == 0 && run != NULL)
+    {
+      *p_entry = *run | UNWRITTEN_BIT;
+      *run += fs_cluster_sectors;
+    }
+    else if (*p_entry == 0)
     {
       /* To pass dir-vine-persistence */
-      if(!free_map_allocate(1, p_entry))
+      if(!free_map_allocate(vol, 1, p_entry))
         return false;
-      cache_write(*p_entry, zeros);
+      zero_cluster(vol->base + *p_entry);
     }
     return true;
   }
@@ -460,73 +867,74 @@ inode_keep_indirect(block_sector_t *p_entry, size_t num_sectors, int level)
   struct inode_indirect_block_sector indirect_block;
   if (*p_entry == 0)
   {
+    size_t s;
+
     /* To pass dir-vine-persistence */
-    if(!free_map_allocate(1, p_entry))
+    if(!free_map_allocate(vol, 1, p_entry))
       return false;
-    cache_write(*p_entry, zeros);
-
+    for (s = 0; s < fs_index_sectors; s++)
+      cache_write_meta(vol->base + *p_entry + s, zeros);
   }
-  
-  cache_read(*p_entry, &indirect_block);
 
-  size_t unit = (level == 1 ? 1 : INDIRECT_BLOCKS_PER_SECTOR);
+  size_t unit = (level == 1 ? 1 : INDEX_PTRS);
   size_t i, l = DIV_ROUND_UP(num_sectors, unit);
 
   for (i = 0; i < l; ++i)
   {
     size_t subsize = minest(num_sectors, unit);
-
-    if(!inode_keep_indirect(&indirect_block.blocks[i], subsize, level - 1))
+    size_t slot = i % INDIRECT_BLOCKS_PER_SECTOR;
+    block_sector_t sector = vol->base + *p_entry + i / INDIRECT_BLOCKS_PER_SECTOR;
+    bool ok;
+
+    if (slot == 0)
+      cache_read_meta(sector, &indirect_block);
+    ok = inode_keep_indirect(vol, &indirect_block.blocks[slot], subsize, level - 1, run);
+    // write back each sector of pointers once it is done with
+    if (!ok || slot == INDIRECT_BLOCKS_PER_SECTOR - 1 || i == l - 1)
+      cache_write_meta(sector, &indirect_block);
+    if (!ok)
       return false;
 
     num_sectors -= subsize;
   }
 
   ASSERT(num_sectors == 0);
-  cache_write(*p_entry, &indirect_block);
   return true;
 }
 
 static bool
-inode_keep(struct inode_disk *disk_inode, off_t length)
+inode_keep(struct volume *vol, struct inode_disk *disk_inode, off_t length,
+           block_sector_t *run)
 {
-  static char zeros[BLOCK_SECTOR_SIZE];
-
 
   if (length < 0)
     return false;
 
 
-  size_t num_sectors = bytes_to_sectors(length);
+  size_t num_sectors = bytes_to_clusters(length);
   size_t i, l;
 
 
   l = minest(num_sectors, DIRECT_BLOCKS_COUNT * 1);
   for (i = 0; i < l; ++i)
   {
-
-    if (disk_inode->direct_blocks[i] == 0)
-    { 
-      /* To pass dir-vine-persistence */
-      if(!free_map_allocate(1, &disk_inode->direct_blocks[i]))
-        return false;
-      cache_write(disk_inode->direct_blocks[i], zeros);
-    }
+    if (!inode_keep_indirect(vol, &disk_inode->direct_blocks[i], 1, 0, run))
+      return false;
   }
   num_sectors = num_sectors - l;
   if (num_sectors == 0)
     return true;
 
 
-  l = minest(num_sectors, 1 * INDIRECT_BLOCKS_PER_SECTOR);
-  if(!inode_keep_indirect(&disk_inode->indirect_block, l, 1))
+  l = minest(num_sectors, 1 * INDEX_PTRS);
+  if(!inode_keep_indirect(vol, &disk_inode->indirect_block, l, 1, run))
     return false;
   num_sectors = num_sectors - l;
   if (num_sectors == 0)
     return true;
 
-  l = minest(num_sectors, 1 * INDIRECT_BLOCKS_PER_SECTOR * INDIRECT_BLOCKS_PER_SECTOR);
-  if(!inode_keep_indirect(&disk_inode->doubly_indirect_block, l, 2))
+  l = minest(num_sectors, 1 * INDEX_PTRS * INDEX_PTRS);
+  if(!inode_keep_indirect(vol, &disk_inode->doubly_indirect_block, l, 2, run))
     return false;
 
   num_sectors = num_sectors - l;
@@ -537,33 +945,109 @@ inode_keep(struct inode_disk *disk_inode, off_t length)
   return false;
 }
 
+/* Releases data clusters LO up to HI, counted from the first
+   cluster that index block *P_ENTRY of the given LEVEL covers.
+   Frees the index block too, and clears *P_ENTRY, if nothing
+   below it remains. */
+static void
+inode_shrink_indirect(struct volume *vol, block_sector_t *p_entry, size_t lo, size_t hi, int level)
+{
+  struct inode_indirect_block_sector indirect_block;
+  size_t unit = (level == 1 ? 1 : INDEX_PTRS);
+  size_t i, first = lo / unit, last = DIV_ROUND_UP(hi, unit);
+
+  ASSERT(level == 1 || level == 2);
+
+  for (i = first; i < last; ++i)
+  {
+    size_t slot = i % INDIRECT_BLOCKS_PER_SECTOR;
+    block_sector_t sector = vol->base + *p_entry + i / INDIRECT_BLOCKS_PER_SECTOR;
+
+    if (i == first || slot == 0)
+      cache_read_meta(sector, &indirect_block);
+    if (level == 1)
+    {
+      free_map_release(vol, ENTRY_SECTOR(indirect_block.blocks[slot]), 1);
+      indirect_block.blocks[slot] = 0;
+    }
+    else
+    {
+      // the child clears its own slot, and only if it was emptied;
+      // a partly freed child keeps its surviving clusters
+      size_t base = i * unit;
+      size_t sub_lo = (lo > base ? lo - base : 0);
+      size_t sub_hi = minest(hi - base, unit);
+      inode_shrink_indirect(vol, &indirect_block.blocks[slot], sub_lo, sub_hi, 1);
+    }
+    // a block about to be freed needn't be written back
+    if (lo != 0 && (slot == INDIRECT_BLOCKS_PER_SECTOR - 1 || i == last - 1))
+      cache_write_meta(sector, &indirect_block);
+  }
+
+  if (lo == 0)
+  {
+    free_map_release(vol, *p_entry, 1);
+    *p_entry = 0;
+  }
+}
+
+/* Releases the data clusters of DISK_INODE from index
+   NEW_SECTORS up to OLD_SECTORS, along with any index blocks
+   left empty, and clears the pointers to them. */
 static void
-inode_de_indirect(block_sector_t entry, size_t num_sectors, int level)
+inode_shrink(struct volume *vol, struct inode_disk *disk_inode, size_t new_sectors, size_t old_sectors)
+{
+  size_t base, i;
+
+  for (i = new_sectors; i < old_sectors && i < DIRECT_BLOCKS_COUNT; ++i)
+  {
+    free_map_release(vol, ENTRY_SECTOR(disk_inode->direct_blocks[i]), 1);
+    disk_inode->direct_blocks[i] = 0;
+  }
+
+  base = DIRECT_BLOCKS_COUNT;
+  if (old_sectors > base && new_sectors < base + INDEX_PTRS)
+    inode_shrink_indirect(vol, &disk_inode->indirect_block,
+                          new_sectors > base ? new_sectors - base : 0,
+                          minest(old_sectors - base, INDEX_PTRS), 1);
+
+  base += INDEX_PTRS;
+  if (old_sectors > base)
+    inode_shrink_indirect(vol, &disk_inode->doubly_indirect_block,
+                          new_sectors > base ? new_sectors - base : 0,
+                          old_sectors - base, 2);
+}
+
+static void
+inode_de_indirect(struct volume *vol, block_sector_t entry, size_t num_sectors, int level)
 {
   
   ASSERT(level <= 2);
 
   if (level == 0)
   {
-    free_map_release(entry, 1);
+    free_map_release(vol, ENTRY_SECTOR(entry), 1);
     return;
   }
 
   struct inode_indirect_block_sector indirect_block;
-  cache_read(entry, &indirect_block);
 
-  size_t unit = (level == 1 ? 1 : INDIRECT_BLOCKS_PER_SECTOR);
+  size_t unit = (level == 1 ? 1 : INDEX_PTRS);
   size_t i, l = DIV_ROUND_UP(num_sectors, unit);
 
   for (i = 0; i < l; ++i)
   {
     size_t subsize = minest(num_sectors, unit);
-    inode_de_indirect(indirect_block.blocks[i], subsize, level - 1);
+    size_t slot = i % INDIRECT_BLOCKS_PER_SECTOR;
+    if (slot == 0)
+      cache_read_meta(vol->base + entry + i / INDIRECT_BLOCKS_PER_SECTOR,
+                      &indirect_block);
+    inode_de_indirect(vol, indirect_block.blocks[slot], subsize, level - 1);
     num_sectors = num_sectors - subsize;
   }
 
   ASSERT(num_sectors == 0);
-  free_map_release(entry, 1);
+  free_map_release(vol, entry, 1);
 }
 
 static bool inode_deallocate(struct inode *inode)
@@ -573,34 +1057,167 @@ static bool inode_deallocate(struct inode *inode)
     return false;
 
  
-  size_t num_sectors = bytes_to_sectors(file_length);
+  size_t num_sectors = bytes_to_clusters(file_length);
   size_t i, l;
 
   
   l = minest(num_sectors, DIRECT_BLOCKS_COUNT * 1);
   for (i = 0; i < l; ++i)
   {
-    free_map_release(inode->data.direct_blocks[i], 1);
+    free_map_release(inode->vol, ENTRY_SECTOR(inode->data.direct_blocks[i]), 1);
   }
   num_sectors = num_sectors - l;
 
 
-  l = minest(num_sectors, 1 * INDIRECT_BLOCKS_PER_SECTOR);
+  l = minest(num_sectors, 1 * INDEX_PTRS);
 
   if (l > 0)
   {
-    inode_de_indirect(inode->data.indirect_block, l, 1);
+    inode_de_indirect(inode->vol, inode->data.indirect_block, l, 1);
     num_sectors = num_sectors - l;
   }
 
  
-  l = minest(num_sectors, 1 * INDIRECT_BLOCKS_PER_SECTOR * INDIRECT_BLOCKS_PER_SECTOR);
+  l = minest(num_sectors, 1 * INDEX_PTRS * INDEX_PTRS);
   if (l > 0)
   {
-    inode_de_indirect(inode->data.doubly_indirect_block, l, 2);
+    inode_de_indirect(inode->vol, inode->data.doubly_indirect_block, l, 2);
     num_sectors = num_sectors - l;
   }
 
   ASSERT(num_sectors == 0);
   return true;
 }
+
+/* Returns the number of runs of physically contiguous clusters
+   among the first CNT data clusters of IDISK. */
+static size_t
+count_extents(const struct volume *vol, const struct inode_disk *idisk, size_t cnt)
+{
+  block_sector_t prev = 0;
+  size_t extents = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+  {
+    block_sector_t sector = sector_to_index(vol, idisk, i, NULL);
+    if (i == 0 || sector != prev + fs_cluster_sectors)
+      extents++;
+    prev = sector;
+  }
+  return extents;
+}
+
+/* Points data cluster INDEX of IDISK, an inode on VOL, at the
+   cluster whose inode number is SECTOR, and marks it unwritten
+   if UNWRITTEN is true.  Index blocks are written through the
+   journal; the caller writes IDISK. */
+static void
+set_index(const struct volume *vol, struct inode_disk *idisk, size_t index,
+          block_sector_t sector, bool unwritten)
+{
+  sector -= vol->base;
+  if (unwritten)
+    sector |= UNWRITTEN_BIT;
+  if (index < DIRECT_BLOCKS_COUNT)
+  {
+    idisk->direct_blocks[index] = sector;
+    return;
+  }
+  index -= DIRECT_BLOCKS_COUNT;
+
+  if (index < INDEX_PTRS)
+  {
+    index_set(vol, idisk->indirect_block, index, sector);
+    return;
+  }
+  index -= INDEX_PTRS;
+
+  index_set(vol, index_get(vol, idisk->doubly_indirect_block, index / INDEX_PTRS),
+            index % INDEX_PTRS, sector);
+}
+
+/* Moves the data of INODE, which must be an ordinary file, into
+   one run of contiguous free clusters, and fills in STATS.  The
+   copy goes around the buffer cache, in the idle I/O class and
+   without any lock held, so nobody waits on it.  Then, holding
+   the file lock that writers take, the pointers switch over and
+   the old clusters are freed in one journal handle, so a crash
+   leaves either the old layout or the new one.  If the file was
+   written during the copy, the new run is given back instead.
+   Index blocks stay where they are.
+   The file may stay open, but the caller must not hold the file
+   lock.
+   Returns true if the file ends up in a single run, false if it
+   is a directory or in tmpfs, no run of free clusters is long
+   enough, or it was written during the copy. */
+bool inode_defrag(struct inode *inode, struct defrag_stats *stats)
+{
+  size_t cnt = bytes_to_clusters(inode->data.length);
+  unsigned gen = inode->write_gen;
+  char buffer[BLOCK_SECTOR_SIZE];
+  enum block_ioprio ioprio;
+  block_sector_t start;
+  bool moved;
+  size_t i, j;
+
+  if (inode->tmpfs != NULL)
+  {
+    stats->clusters = stats->extents_before = stats->extents_after = 0;
+    return false;
+  }
+
+  stats->clusters = cnt;
+  stats->extents_before = count_extents(inode->vol, &inode->data, cnt);
+  stats->extents_after = stats->extents_before;
+  if (is_meta(inode))
+    return false;
+  if (stats->extents_before <= 1)
+    return true;
+  if (!free_map_allocate(inode->vol, cnt, &start))
+    return false;
+  start += inode->vol->base;
+
+  // unwritten clusters read as zeros wherever they are
+  ioprio = block_set_ioprio(BLOCK_IOPRIO_IDLE);
+  for (i = 0; i < cnt; i++)
+  {
+    bool unwritten;
+    block_sector_t old = sector_to_index(inode->vol, &inode->data, i, &unwritten);
+    if (unwritten)
+      continue;
+    for (j = 0; j < fs_cluster_sectors; j++)
+    {
+      cache_read_direct(old + j, buffer);
+      cache_write_direct(start + i * fs_cluster_sectors + j, buffer);
+    }
+  }
+  block_set_ioprio(ioprio);
+
+  acquire_file_lock();
+  moved = inode->write_gen == gen;
+  if (moved)
+  {
+    journal_begin();
+    for (i = 0; i < cnt; i++)
+    {
+      bool unwritten;
+      block_sector_t old = sector_to_index(inode->vol, &inode->data, i, &unwritten);
+      set_index(inode->vol, &inode->data, i, start + i * fs_cluster_sectors,
+                unwritten);
+      free_map_release(inode->vol, old - inode->vol->base, 1);
+    }
+    cache_write_meta(inode->sector, &inode->data);
+    inode->write_gen++;
+    journal_end();
+  }
+  release_file_lock();
+  if (!moved)
+  {
+    free_map_release(inode->vol, start - inode->vol->base, cnt);
+    return false;
+  }
+
+  stats->extents_after = count_extents(inode->vol, &inode->data, cnt);
+  return true;
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "threads/thread.h"
+#include "threads/synch.h"
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
@@ -12,11 +13,13 @@
 #define INDIRECT_BLOCKS_PER_SECTOR 128
 
 struct bitmap;
+struct volume;
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
 {
+  /* Each pointer is the first sector of a cluster. */
   block_sector_t direct_blocks[DIRECT_BLOCKS_COUNT];
   block_sector_t indirect_block;
   block_sector_t doubly_indirect_block;
@@ -32,15 +35,34 @@ struct inode
     struct list_elem elem;              /* Element in inode list. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
+    bool loading;                       /* Disk inode still being read? */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t dir_free_ofs;                 /* Directories: no free slot before. */
+    int dir_entry_cnt;                  /* Directories: in use, -1 unknown. */
+    struct lock dir_lock;               /* Directories: guards entries. */
+    unsigned write_gen;                 /* Bumped by each write, for
+                                           inode_defrag(). */
+    struct tmpfs_node *tmpfs;           /* Memory-only inode, or null. */
+    struct volume *vol;                 /* Volume holding it, or null. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* One sector of an index block, which spans fs_index_sectors
+   sectors. */
 struct inode_indirect_block_sector {
 	  block_sector_t blocks[INDIRECT_BLOCKS_PER_SECTOR];
 	};
 
+/* Fragmentation of a file's data, as reported by inode_defrag().
+   The layout matches struct defrag_stats in lib/user/syscall.h. */
+struct defrag_stats
+  {
+    int32_t clusters;                   /* Data clusters in the file. */
+    int32_t extents_before;             /* Contiguous runs beforehand. */
+    int32_t extents_after;              /* Contiguous runs afterward. */
+  };
+
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool is_dir); 
 struct inode *inode_open (block_sector_t);
@@ -50,8 +72,18 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_direct_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_write_direct_at (struct inode *, const void *, off_t size,
+                             off_t offset);
+void inode_truncate (struct inode *, off_t length);
+bool inode_fallocate (struct inode *, off_t length);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_defrag (struct inode *, struct defrag_stats *);
+void inode_prefetch (struct inode *, off_t offset, off_t length);
+void inode_discard (struct inode *, off_t offset, off_t length);
+void inode_demote (struct inode *, off_t offset, off_t length);
+void inode_sync (struct inode *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,777 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Inode sectors, index blocks, directory contents and the free
+   map are written through journal_add() instead of straight to
+   disk.  Each update is copied into the running transaction,
+   and the buffer cache keeps its copy clean so that it never
+   writes a metadata sector home by itself.
+
+   A commit appends the running transaction to the log as one
+   sequential run of sectors: descriptor sectors naming the
+   sectors that follow them, the block images themselves, and a
+   checksum over all of it in the last descriptor.  A torn
+   commit fails the checksum and is ignored by replay, so no
+   separate commit record has to be written after the data.
+
+   Once a transaction is in the log its blocks may be written to
+   their home locations at leisure.  That is the checkpoint.
+   The log is linear: when every committed transaction has been
+   checkpointed, the header is rewritten to start a fresh log at
+   the beginning of the region.  The commit thread checkpoints
+   once the log is half full, so that many commits share one
+   round of home writes; a commit that finds no room does it
+   right away.  journal_lock is dropped for each home write, so
+   journal_read() is not held up by the disk.
+
+   File system operations bracket their updates with
+   journal_begin() and journal_end().  Every update made inside
+   such a handle lands in the same transaction, and a commit
+   waits for the open handles to finish, so concurrent
+   operations are committed together by one log write.  While it
+   waits, new handles wait too, then start the next transaction,
+   so a steady stream of operations can't hold off a commit.
+   Nor does a handle join a transaction that already fills half
+   the log: journal_begin() commits that one first, so that every
+   transaction fits in the log with room for its open handles.
+
+   Because journal_begin() can wait for open handles, no thread
+   may call it, outside a handle it already has, while holding a
+   lock that a thread with an open handle might wait for.  Take
+   a directory's dir_lock, open_inodes_lock and the like only
+   inside the handle.  The global file_lock in userprog/syscall.c
+   is taken before any handle, so it is fine. */
+
+/* Header sector at JOURNAL_SECTOR. */
+#define JOURNAL_MAGIC 0x4c4e524a        /* "JRNL". */
+struct journal_header
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence of first logged txn. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* Descriptor sector in the log. */
+#define DESC_MAGIC 0x43534544           /* "DESC". */
+#define DESC_ENTRIES 122
+struct journal_desc
+  {
+    uint32_t magic;                     /* DESC_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t block_cnt;                 /* Block images following. */
+    uint32_t revoke_cnt;                /* Revoked sectors after those. */
+    uint32_t last;                      /* Nonzero in final descriptor. */
+    uint32_t checksum;                  /* Whole transaction, if last. */
+    block_sector_t entries[DESC_ENTRIES]; /* Block sectors, then revokes. */
+  };
+
+/* Number of blocks in the running transaction that wakes the
+   commit thread. */
+#define JOURNAL_COMMIT_BLOCKS 32
+
+/* Log sectors the running transaction may take up before
+   journal_begin() commits it rather than let another handle
+   join.  The rest of the log is left for the handles already
+   open, so that no transaction outgrows the log. */
+#define JOURNAL_TXN_SECTORS (JOURNAL_SECTORS / 2)
+
+/* A transaction. */
+struct journal_txn
+  {
+    struct list_elem elem;              /* Element in committed list. */
+    uint32_t seq;                       /* Sequence number, once logged. */
+    struct list blocks;                 /* Block images. */
+    size_t block_cnt;                   /* Number of block images. */
+    struct list revokes;                /* Revoked sectors. */
+    size_t revoke_cnt;                  /* Number of revoked sectors. */
+    int handle_cnt;                     /* Operations still adding to it. */
+  };
+
+/* The image of one sector within a transaction. */
+struct journal_block
+  {
+    struct list_elem elem;              /* Element in txn's blocks. */
+    struct hash_elem hash_elem;         /* Element in newest, if newest. */
+    struct journal_txn *txn;            /* Owning transaction. */
+    block_sector_t sector;              /* Home location. */
+    bool newest;                        /* Most recent image of SECTOR? */
+    bool revoked;                       /* Sector freed, don't write home. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Contents. */
+  };
+
+/* A sector freed by a transaction.  Replay must not write back
+   images of it from older transactions. */
+struct journal_revoke
+  {
+    struct list_elem elem;              /* Element in txn's revokes. */
+    block_sector_t sector;              /* Freed sector. */
+    uint32_t seq;                       /* Revoking txn, during replay. */
+  };
+
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition handles_done;   /* A closing txn's handles ended. */
+static struct condition txn_open;       /* RUNNING takes handles again. */
+static struct condition commit_done;    /* A commit finished. */
+static struct condition home_written;   /* HOMING was written home. */
+static struct condition checkpoint_done; /* CHECKPOINTING was cleared. */
+
+static struct journal_txn *running;     /* Accepting updates. */
+static struct journal_txn *committing;  /* Being written to the log. */
+static struct list committed;           /* Logged, not checkpointed. */
+static struct hash newest;              /* Newest image of each sector. */
+static uint32_t next_seq;               /* Sequence for the next commit. */
+static uint32_t log_seq;                /* Sequence in the header. */
+static block_sector_t log_tail;         /* Next free log sector. */
+static bool checkpointing;              /* A checkpoint is running? */
+static struct journal_block *homing;    /* Block being written home. */
+
+/* Wakes the commit thread. */
+static struct semaphore commit_sema;
+
+static thread_func journal_thread NO_RETURN;
+static hash_hash_func block_hash;
+static hash_less_func block_less;
+
+/* Returns the device sector of log sector OFS. */
+static inline block_sector_t
+log_sector (block_sector_t ofs)
+{
+  return JOURNAL_SECTOR + 1 + ofs;
+}
+
+/* Adds SIZE bytes from BUF to running checksum SUM (FNV-1a). */
+static uint32_t
+checksum (uint32_t sum, const void *buf_, size_t size)
+{
+  const uint8_t *buf = buf_;
+
+  while (size-- > 0)
+    sum = (sum ^ *buf++) * 16777619;
+  return sum;
+}
+#define CHECKSUM_BASIS 2166136261u
+
+/* Returns a new, empty transaction. */
+static struct journal_txn *
+txn_create (void)
+{
+  struct journal_txn *t = malloc (sizeof *t);
+  if (t == NULL)
+    PANIC ("journal: out of memory");
+  t->seq = 0;
+  list_init (&t->blocks);
+  t->block_cnt = 0;
+  list_init (&t->revokes);
+  t->revoke_cnt = 0;
+  t->handle_cnt = 0;
+  return t;
+}
+
+/* Returns true if T has nothing to commit. */
+static bool
+txn_empty (const struct journal_txn *t)
+{
+  return t->block_cnt == 0 && t->revoke_cnt == 0;
+}
+
+/* Writes the header for a log that is empty up to LOG_SEQ. */
+static void
+write_header (void)
+{
+  static struct journal_header h;
+
+  h.magic = JOURNAL_MAGIC;
+  h.seq = log_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &h);
+  block_flush (fs_device);
+}
+
+/* Returns the number of log sectors that T occupies. */
+static size_t
+txn_sectors (const struct journal_txn *t)
+{
+  size_t entries = t->block_cnt + t->revoke_cnt;
+  size_t desc_cnt = entries > 0 ? DIV_ROUND_UP (entries, DESC_ENTRIES) : 1;
+  return desc_cnt + t->block_cnt;
+}
+
+/* Walks T as it is laid out in the log starting at log sector
+   POS, computing its checksum.  If WRITE is true, also writes
+   it out, storing FINAL as the checksum in the last descriptor.
+   Returns the checksum. */
+static uint32_t
+lay_out_txn (struct journal_txn *t, block_sector_t pos, bool write,
+             uint32_t final)
+{
+  static struct journal_desc d;
+  struct list_elem *b = list_begin (&t->blocks);
+  struct list_elem *r = list_begin (&t->revokes);
+  uint32_t sum = CHECKSUM_BASIS;
+  bool last = false;
+
+  while (!last)
+    {
+      struct list_elem *first = b;
+      size_t n = 0, i;
+
+      memset (&d, 0, sizeof d);
+      d.magic = DESC_MAGIC;
+      d.seq = t->seq;
+      for (; n < DESC_ENTRIES && b != list_end (&t->blocks); b = list_next (b))
+        {
+          d.entries[n++] = list_entry (b, struct journal_block, elem)->sector;
+          d.block_cnt++;
+        }
+      for (; n < DESC_ENTRIES && r != list_end (&t->revokes); r = list_next (r))
+        {
+          d.entries[n++] = list_entry (r, struct journal_revoke, elem)->sector;
+          d.revoke_cnt++;
+        }
+      last = b == list_end (&t->blocks) && r == list_end (&t->revokes);
+      d.last = last;
+
+      sum = checksum (sum, d.entries, sizeof d.entries);
+      if (write)
+        {
+          d.checksum = last ? final : 0;
+          block_write (fs_device, log_sector (pos++), &d);
+        }
+      for (i = 0; i < d.block_cnt; i++, first = list_next (first))
+        {
+          struct journal_block *jb = list_entry (first, struct journal_block,
+                                                 elem);
+          sum = checksum (sum, jb->data, BLOCK_SECTOR_SIZE);
+          if (write)
+            block_write (fs_device, log_sector (pos++), jb->data);
+        }
+    }
+  return sum;
+}
+
+/* Writes T to the log at log sector POS.  Data already written
+   around the cache, such as the zeros of a preallocated cluster,
+   is flushed first, so that it is on disk before any metadata in
+   T that points at it. */
+static void
+write_txn (struct journal_txn *t, block_sector_t pos)
+{
+  block_flush (fs_device);
+  lay_out_txn (t, pos, true, lay_out_txn (t, pos, false, 0));
+  block_flush (fs_device);
+}
+
+/* Writes the blocks of T, which must not be the running
+   transaction, to their home locations.  Must be called with
+   journal_lock held, but releases it during each write.  T's
+   blocks don't change meanwhile, and journal_read() can still
+   find them; journal_forget() waits for a block it is revoking
+   to finish being written. */
+static void
+write_home (struct journal_txn *t)
+{
+  struct list_elem *e;
+
+  ASSERT (t != running);
+  for (e = list_begin (&t->blocks); e != list_end (&t->blocks);
+       e = list_next (e))
+    {
+      struct journal_block *jb = list_entry (e, struct journal_block, elem);
+      if (jb->revoked)
+        continue;
+      homing = jb;
+      lock_release (&journal_lock);
+      block_write (fs_device, jb->sector, jb->data);
+      lock_acquire (&journal_lock);
+      homing = NULL;
+      cond_broadcast (&home_written, &journal_lock);
+    }
+}
+
+/* Frees T and its blocks, which must already be home. */
+static void
+txn_destroy (struct journal_txn *t)
+{
+  while (!list_empty (&t->blocks))
+    {
+      struct journal_block *jb = list_entry (list_pop_front (&t->blocks),
+                                             struct journal_block, elem);
+      if (jb->newest)
+        hash_delete (&newest, &jb->hash_elem);
+      free (jb);
+    }
+  while (!list_empty (&t->revokes))
+    free (list_entry (list_pop_front (&t->revokes),
+                      struct journal_revoke, elem));
+  free (t);
+}
+
+/* Writes every committed transaction home and, unless a commit
+   is writing to the log, empties the log.  Must be called with
+   journal_lock held, which is released while writing. */
+static void
+checkpoint (void)
+{
+  while (checkpointing)
+    cond_wait (&checkpoint_done, &journal_lock);
+  checkpointing = true;
+
+  while (!list_empty (&committed))
+    {
+      struct journal_txn *t = list_entry (list_front (&committed),
+                                          struct journal_txn, elem);
+      write_home (t);
+      list_remove (&t->elem);
+      txn_destroy (t);
+    }
+
+  /* A commit has only taken log space once it has a sequence
+     number. */
+  if ((committing == NULL || committing->seq == 0) && log_tail > 0)
+    {
+      log_seq = next_seq;
+      log_tail = 0;
+      write_header ();
+    }
+
+  checkpointing = false;
+  cond_broadcast (&checkpoint_done, &journal_lock);
+}
+
+/* Commits the running transaction, waiting for its open handles
+   to finish first.  Must be called with journal_lock held and
+   without an open handle. */
+static void
+commit_running (void)
+{
+  struct journal_txn *t;
+  size_t size;
+  block_sector_t pos;
+
+  while (committing != NULL)
+    cond_wait (&commit_done, &journal_lock);
+  t = running;
+  if (txn_empty (t))
+    return;
+
+  /* Close T to new handles and let the open ones finish, then
+     start the next transaction for the handles that waited. */
+  committing = t;
+  while (t->handle_cnt > 0)
+    cond_wait (&handles_done, &journal_lock);
+  running = txn_create ();
+  cond_broadcast (&txn_open, &journal_lock);
+
+  /* Find room in the log, checkpointing to free it if needed. */
+  size = txn_sectors (t);
+  if (log_tail + size > JOURNAL_SECTORS)
+    checkpoint ();
+  if (size > JOURNAL_SECTORS)
+    PANIC ("journal: transaction of %zu sectors doesn't fit in the log",
+           size);
+  t->seq = next_seq++;
+  pos = log_tail;
+  log_tail += size;
+
+  /* Blocks of T no longer change, so other threads may keep
+     adding to the new running transaction meanwhile. */
+  lock_release (&journal_lock);
+  write_txn (t, pos);
+  lock_acquire (&journal_lock);
+
+  list_push_back (&committed, &t->elem);
+  committing = NULL;
+  cond_broadcast (&commit_done, &journal_lock);
+  if (log_tail > JOURNAL_SECTORS / 2)
+    sema_up (&commit_sema);
+}
+
+/* Replay record: is SECTOR revoked by a transaction newer than
+   SEQ, up to LAST? */
+static bool
+is_revoked (struct list *revokes, block_sector_t sector, uint32_t seq,
+            uint32_t last)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (revokes); e != list_end (revokes); e = list_next (e))
+    {
+      struct journal_revoke *r = list_entry (e, struct journal_revoke, elem);
+      if (r->sector == sector && r->seq > seq && r->seq <= last)
+        return true;
+    }
+  return false;
+}
+
+/* Scans the transaction with sequence SEQ at log sector *POS.
+   Returns true and advances *POS past it if it is complete and
+   intact.  If REVOKES is non-null, appends its revoke records
+   to it.  If APPLY is true, also writes its blocks home, except
+   those revoked in REVOKES by a transaction up to LAST. */
+static bool
+scan_txn (uint32_t seq, block_sector_t *pos, struct list *revokes,
+          bool apply, uint32_t last)
+{
+  static struct journal_desc d;
+  static uint8_t block[BLOCK_SECTOR_SIZE];
+  uint32_t sum = CHECKSUM_BASIS;
+  block_sector_t p = *pos;
+
+  for (;;)
+    {
+      size_t i;
+
+      if (p >= JOURNAL_SECTORS)
+        return false;
+      block_read (fs_device, log_sector (p++), &d);
+      if (d.magic != DESC_MAGIC || d.seq != seq
+          || d.block_cnt + d.revoke_cnt > DESC_ENTRIES
+          || p + d.block_cnt > JOURNAL_SECTORS)
+        return false;
+      sum = checksum (sum, d.entries, sizeof d.entries);
+      for (i = 0; i < d.block_cnt; i++)
+        {
+          block_read (fs_device, log_sector (p++), block);
+          sum = checksum (sum, block, BLOCK_SECTOR_SIZE);
+          if (apply && !is_revoked (revokes, d.entries[i], seq, last))
+            block_write (fs_device, d.entries[i], block);
+        }
+      for (i = 0; revokes != NULL && !apply && i < d.revoke_cnt; i++)
+        {
+          struct journal_revoke *r = malloc (sizeof *r);
+          if (r == NULL)
+            PANIC ("journal: out of memory");
+          r->sector = d.entries[d.block_cnt + i];
+          r->seq = seq;
+          list_push_back (revokes, &r->elem);
+        }
+      if (d.last)
+        break;
+    }
+  if (sum != d.checksum)
+    return false;
+  *pos = p;
+  return true;
+}
+
+/* Replays the committed transactions in the log, then empties
+   it. */
+static void
+replay (const struct journal_header *h)
+{
+  struct list revokes;
+  block_sector_t pos;
+  uint32_t seq, last;
+
+  /* Find the intact transactions and what they revoke.  The
+     revoke records of a torn transaction have a sequence number
+     past LAST, so they are ignored. */
+  list_init (&revokes);
+  pos = 0;
+  for (seq = h->seq; scan_txn (seq, &pos, &revokes, false, 0); seq++)
+    continue;
+  last = seq - 1;
+
+  /* Write them home, oldest first. */
+  pos = 0;
+  for (seq = h->seq; seq <= last; seq++)
+    scan_txn (seq, &pos, &revokes, true, last);
+
+  while (!list_empty (&revokes))
+    free (list_entry (list_pop_front (&revokes),
+                      struct journal_revoke, elem));
+
+  log_seq = next_seq = last + 1;
+  log_tail = 0;
+  write_header ();
+}
+
+/* Initializes the journal.  If FORMAT is true, creates an empty
+   log, otherwise recovers the committed contents of the existing
+   one.  A file system without a log that was formatted before
+   the log region was reserved may have file data there, so
+   unless RESERVED says it was reserved, the journal is left off
+   for it.  Returns true if the journal is in use. */
+bool
+journal_init (bool format, bool reserved)
+{
+  static struct journal_header h;
+
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_desc) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&handles_done);
+  cond_init (&txn_open);
+  cond_init (&commit_done);
+  cond_init (&home_written);
+  cond_init (&checkpoint_done);
+  sema_init (&commit_sema, 0);
+  list_init (&committed);
+  hash_init (&newest, block_hash, block_less, NULL);
+  running = txn_create ();
+  committing = NULL;
+  checkpointing = false;
+  homing = NULL;
+
+  log_seq = next_seq = 1;
+  log_tail = 0;
+
+  block_read (fs_device, JOURNAL_SECTOR, &h);
+  if (!format && h.magic == JOURNAL_MAGIC)
+    replay (&h);
+  else if (format || reserved)
+    write_header ();
+  else
+    {
+      printf ("journal: %s has no log, not journaling\n",
+              block_name (fs_device));
+      return false;
+    }
+
+  thread_create ("journal", PRI_DEFAULT, journal_thread, NULL);
+  return true;
+}
+
+/* Commits and checkpoints everything, leaving the log empty. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  commit_running ();
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Starts a file system operation.  Updates made until the
+   matching journal_end() are committed atomically.  Calls nest,
+   and the outermost pair decides the transaction.
+
+   If a commit is waiting for the running transaction's handles
+   to finish, waits for it to start the next transaction, and if
+   the running transaction is already large, commits it first.
+   Either way the caller must not hold a lock that an open
+   handle may need (see the comment at the top of this file). */
+void
+journal_begin (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->journal_depth++ > 0)
+    return;
+  lock_acquire (&journal_lock);
+  if (committing != running && txn_sectors (running) >= JOURNAL_TXN_SECTORS)
+    commit_running ();
+  while (committing == running)
+    cond_wait (&txn_open, &journal_lock);
+  running->handle_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends the operation started by journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *cur = thread_current ();
+  bool full;
+
+  ASSERT (cur->journal_depth > 0);
+  if (--cur->journal_depth > 0)
+    return;
+  lock_acquire (&journal_lock);
+  if (--running->handle_cnt == 0 && committing == running)
+    cond_broadcast (&handles_done, &journal_lock);
+  full = running->block_cnt >= JOURNAL_COMMIT_BLOCKS;
+  lock_release (&journal_lock);
+
+  if (full)
+    sema_up (&commit_sema);
+}
+
+/* Makes every update completed so far durable.  Concurrent
+   callers share a single log write. */
+void
+journal_commit (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  commit_running ();
+  lock_release (&journal_lock);
+}
+
+/* Records that SECTOR now holds the BLOCK_SECTOR_SIZE bytes at
+   DATA, as part of the running transaction. */
+void
+journal_add (block_sector_t sector, const void *data)
+{
+  struct journal_block key, *jb;
+  struct hash_elem *e;
+
+  lock_acquire (&journal_lock);
+  key.sector = sector;
+  e = hash_find (&newest, &key.hash_elem);
+  jb = e != NULL ? hash_entry (e, struct journal_block, hash_elem) : NULL;
+  if (jb == NULL || jb->txn != running)
+    {
+      struct journal_block *old = jb;
+
+      jb = malloc (sizeof *jb);
+      if (jb == NULL)
+        PANIC ("journal: out of memory");
+      jb->txn = running;
+      jb->sector = sector;
+      jb->newest = true;
+      jb->revoked = false;
+      list_push_back (&running->blocks, &jb->elem);
+      running->block_cnt++;
+      if (old != NULL)
+        {
+          hash_replace (&newest, &jb->hash_elem);
+          old->newest = false;
+        }
+      else
+        hash_insert (&newest, &jb->hash_elem);
+    }
+  memcpy (jb->data, data, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+}
+
+/* If the journal holds a copy of SECTOR that has not been
+   written home yet, copies it into DATA and returns true.
+   Otherwise returns false. */
+bool
+journal_read (block_sector_t sector, void *data)
+{
+  struct journal_block key;
+  struct hash_elem *e;
+
+  lock_acquire (&journal_lock);
+  key.sector = sector;
+  e = hash_find (&newest, &key.hash_elem);
+  if (e != NULL)
+    memcpy (data, hash_entry (e, struct journal_block, hash_elem)->data,
+            BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return e != NULL;
+}
+
+/* Marks every image of SECTOR in T as revoked.  Returns true if
+   T had any. */
+static bool
+revoke_in (struct journal_txn *t, block_sector_t sector)
+{
+  struct list_elem *e;
+  bool found = false;
+
+  for (e = list_begin (&t->blocks); e != list_end (&t->blocks);
+       e = list_next (e))
+    {
+      struct journal_block *jb = list_entry (e, struct journal_block, elem);
+      if (jb->sector == sector)
+        {
+          jb->revoked = true;
+          found = true;
+        }
+    }
+  return found;
+}
+
+/* Called when SECTOR is freed.  Drops the journal's images of it
+   so that they are never written over whatever the sector is
+   reused for. */
+void
+journal_forget (block_sector_t sector)
+{
+  struct journal_block key;
+  struct hash_elem *e;
+  struct list_elem *l;
+  bool logged = false;
+
+  lock_acquire (&journal_lock);
+  while (homing != NULL && homing->sector == sector)
+    cond_wait (&home_written, &journal_lock);
+  key.sector = sector;
+  e = hash_find (&newest, &key.hash_elem);
+  if (e == NULL)
+    {
+      lock_release (&journal_lock);
+      return;
+    }
+  hash_delete (&newest, e);
+  hash_entry (e, struct journal_block, hash_elem)->newest = false;
+
+  /* An image in the running transaction can simply go away. */
+  for (l = list_begin (&running->blocks); l != list_end (&running->blocks); )
+    {
+      struct journal_block *jb = list_entry (l, struct journal_block, elem);
+      l = list_next (l);
+      if (jb->sector == sector)
+        {
+          list_remove (&jb->elem);
+          running->block_cnt--;
+          free (jb);
+        }
+    }
+
+  /* Logged images must also be cancelled for replay. */
+  if (committing != NULL)
+    logged = revoke_in (committing, sector);
+  for (l = list_begin (&committed); l != list_end (&committed);
+       l = list_next (l))
+    if (revoke_in (list_entry (l, struct journal_txn, elem), sector))
+      logged = true;
+  if (logged)
+    {
+      struct journal_revoke *r = malloc (sizeof *r);
+      if (r == NULL)
+        PANIC ("journal: out of memory");
+      r->sector = sector;
+      list_push_back (&running->revokes, &r->elem);
+      running->revoke_cnt++;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Commits in the background whenever the running transaction
+   grows large, and checkpoints once the log is half full. */
+static void
+journal_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&commit_sema);
+      lock_acquire (&journal_lock);
+      commit_running ();
+      if (log_tail > JOURNAL_SECTORS / 2)
+        checkpoint ();
+      lock_release (&journal_lock);
+    }
+}
+
+/* Hashes a block by sector. */
+static unsigned
+block_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct journal_block, hash_elem)->sector);
+}
+
+/* Orders blocks by sector. */
+static bool
+block_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct journal_block, hash_elem)->sector
+          < hash_entry (b, struct journal_block, hash_elem)->sector);
+}
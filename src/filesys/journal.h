@@ -0,0 +1,22 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Sectors of log space that follow the journal header at
+   JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS 128
+
+bool journal_init (bool format, bool reserved);
+void journal_done (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+
+void journal_add (block_sector_t, const void *);
+bool journal_read (block_sector_t, void *);
+void journal_forget (block_sector_t);
+
+#endif /* filesys/journal.h */
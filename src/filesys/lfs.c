@@ -0,0 +1,566 @@
+#include "filesys/lfs.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Log-structured layout.
+
+   A file system formatted with -lfs does not sit directly on
+   the disk but on a virtual block device provided here.  Every
+   sector written to it, whether inode, index block, directory
+   or file data, is appended to the current segment in memory,
+   and a full segment goes to the disk as one sequential run.
+   A map from virtual ("logical") sector to disk ("physical")
+   sector records where the latest copy of each lives.  Inode
+   numbers are sector numbers in this file system, so the map is
+   its inode map as well.
+
+   Disk layout:
+
+     sector 0                 superblock
+     two checkpoint regions   header sector, then the map
+     segments                 summary sector, then SEG_DATA
+                              data sectors
+
+   A segment's summary names the logical sector of each of its
+   data sectors and carries the segment's sequence number.  It
+   is written after the data, so a segment is believed only as
+   far as its summary says.
+
+   Checkpoints alternate between the two regions.  Mounting
+   loads the newer one and rolls forward through every segment
+   written since.  A segment whose contents have all been
+   superseded becomes free only at the next checkpoint, so the
+   segments that roll-forward needs are never overwritten.
+
+   When free segments run low, a cleaner thread copies the live
+   sectors out of the emptiest segments so that they can be
+   reused.  Only three quarters of the data capacity is exposed
+   as logical sectors, which guarantees it always finds one. */
+
+#define LFS_MAGIC 0x3053464c            /* "LFS0". */
+#define SEG_SECTORS 64                  /* Sectors per segment. */
+#define SEG_DATA (SEG_SECTORS - 1)      /* Data sectors per segment. */
+#define LFS_RESERVE 2                   /* Free segments kept for cleaning. */
+#define LFS_CLEAN_LOW 4                 /* Start cleaning below this... */
+#define LFS_CLEAN_HIGH 8                /* ...and stop at this. */
+
+/* Superblock, at physical sector 0. */
+struct lfs_super
+  {
+    uint32_t magic;                     /* LFS_MAGIC. */
+    uint32_t logical_cnt;               /* Size of the virtual device. */
+    uint32_t cp_sectors;                /* Sectors per checkpoint region. */
+    uint32_t seg_start;                 /* First sector of segment 0. */
+    uint32_t seg_cnt;                   /* Number of segments. */
+    uint32_t unused[123];               /* Not used. */
+  };
+
+/* Checkpoint region header. */
+struct lfs_checkpoint
+  {
+    uint32_t magic;                     /* LFS_MAGIC. */
+    uint32_t seq;                       /* Segments from here on follow. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* Segment summary, first sector of each segment. */
+struct lfs_summary
+  {
+    uint32_t magic;                     /* LFS_MAGIC. */
+    uint32_t seq;                       /* Segment sequence number. */
+    uint32_t cnt;                       /* Data sectors in use. */
+    block_sector_t logical[SEG_DATA];   /* Logical sector of each. */
+    uint32_t unused[128 - 3 - SEG_DATA]; /* Not used. */
+  };
+
+/* Segment states. */
+enum seg_state
+  {
+    SEG_FREE,                           /* Ready for reuse. */
+    SEG_USED,                           /* Holds live data, or current. */
+    SEG_DEAD                            /* Empty, free at next checkpoint. */
+  };
+
+static struct block *disk;              /* Underlying device. */
+static struct lfs_super sb;             /* Its superblock. */
+static struct lock lfs_lock;            /* Protects everything below. */
+
+static block_sector_t *map;             /* Logical to physical, 0 if none. */
+static uint16_t *seg_live;              /* Live sectors per segment. */
+static uint8_t *seg_state;              /* enum seg_state per segment. */
+static size_t free_cnt;                 /* Segments in SEG_FREE. */
+static size_t dead_cnt;                 /* Segments in SEG_DEAD. */
+
+static size_t cur_seg;                  /* Segment being filled. */
+static struct lfs_summary cur_summary;  /* Its summary. */
+static uint8_t *cur_data;               /* Its data sectors. */
+static size_t cur_flushed;              /* Sectors of it on disk. */
+static bool summary_dirty;              /* Summary not on disk? */
+
+static int cp_region;                   /* Region for next checkpoint. */
+static bool cleaning;                   /* Cleaner running? */
+static struct semaphore clean_sema;     /* Wakes the cleaner thread. */
+
+static struct block_operations lfs_operations;
+static thread_func cleaner_thread NO_RETURN;
+static void next_segment (void);
+
+/* Returns the physical sector of segment SEG's summary. */
+static block_sector_t
+seg_base (size_t seg)
+{
+  return sb.seg_start + seg * SEG_SECTORS;
+}
+
+/* Returns the segment that contains physical sector PHYS. */
+static size_t
+seg_of (block_sector_t phys)
+{
+  return (phys - sb.seg_start) / SEG_SECTORS;
+}
+
+/* Returns the data slot within its segment of physical sector
+   PHYS. */
+static size_t
+slot_of (block_sector_t phys)
+{
+  return (phys - sb.seg_start) % SEG_SECTORS - 1;
+}
+
+/* Returns the number of sectors holding the map. */
+static size_t
+map_sectors (void)
+{
+  return DIV_ROUND_UP (sb.logical_cnt * sizeof *map, BLOCK_SECTOR_SIZE);
+}
+
+/* Sets segment SEG to STATE, keeping the counts up to date. */
+static void
+set_state (size_t seg, enum seg_state state)
+{
+  if (seg_state[seg] == SEG_FREE)
+    free_cnt--;
+  else if (seg_state[seg] == SEG_DEAD)
+    dead_cnt--;
+  seg_state[seg] = state;
+  if (state == SEG_FREE)
+    free_cnt++;
+  else if (state == SEG_DEAD)
+    dead_cnt++;
+}
+
+/* Notes that the copy of a sector at PHYS has been superseded. */
+static void
+kill (block_sector_t phys)
+{
+  size_t seg;
+
+  if (phys == 0)
+    return;
+  seg = seg_of (phys);
+  ASSERT (seg_live[seg] > 0);
+  if (--seg_live[seg] == 0 && seg != cur_seg)
+    set_state (seg, SEG_DEAD);
+}
+
+/* Writes the unwritten part of the current segment, then its
+   summary. */
+static void
+flush_segment (void)
+{
+  block_sector_t base = seg_base (cur_seg);
+
+  if (cur_flushed < cur_summary.cnt)
+    {
+      block_write_multiple (disk, base + 1 + cur_flushed,
+                            cur_summary.cnt - cur_flushed,
+                            cur_data + cur_flushed * BLOCK_SECTOR_SIZE);
+      cur_flushed = cur_summary.cnt;
+    }
+  if (summary_dirty)
+    {
+      block_write (disk, base, &cur_summary);
+      summary_dirty = false;
+    }
+}
+
+/* Writes the map to the next checkpoint region, making every
+   dead segment free. */
+static void
+checkpoint (void)
+{
+  static struct lfs_checkpoint cp;
+  block_sector_t base = 1 + cp_region * sb.cp_sectors;
+  size_t i;
+
+  flush_segment ();
+  block_write_multiple (disk, base + 1, map_sectors (), map);
+  cp.magic = LFS_MAGIC;
+  cp.seq = cur_summary.seq;
+  block_write (disk, base, &cp);
+  cp_region = !cp_region;
+
+  for (i = 0; i < sb.seg_cnt; i++)
+    if (seg_state[i] == SEG_DEAD)
+      set_state (i, SEG_FREE);
+}
+
+/* Appends LOGICAL's new contents DATA to the log. */
+static void
+append (block_sector_t logical, const void *data)
+{
+  block_sector_t old = map[logical];
+  size_t slot;
+
+  /* A sector rewritten before its segment is full is updated in
+     place, so hot sectors cost one slot per segment. */
+  if (old != 0 && seg_of (old) == cur_seg)
+    {
+      slot = slot_of (old);
+      memcpy (cur_data + slot * BLOCK_SECTOR_SIZE, data, BLOCK_SECTOR_SIZE);
+      if (slot < cur_flushed)
+        cur_flushed = slot;
+      return;
+    }
+
+  if (cur_summary.cnt == SEG_DATA)
+    next_segment ();
+  slot = cur_summary.cnt++;
+  cur_summary.logical[slot] = logical;
+  summary_dirty = true;
+  memcpy (cur_data + slot * BLOCK_SECTOR_SIZE, data, BLOCK_SECTOR_SIZE);
+  map[logical] = seg_base (cur_seg) + 1 + slot;
+  seg_live[cur_seg]++;
+  kill (old);
+}
+
+/* Copies the live sectors of segment SEG to the head of the
+   log, leaving SEG dead. */
+static void
+clean_segment (size_t seg)
+{
+  static struct lfs_summary s;
+  static uint8_t buf[BLOCK_SECTOR_SIZE];
+  block_sector_t base = seg_base (seg);
+  size_t i;
+
+  block_read (disk, base, &s);
+  for (i = 0; i < s.cnt && seg_live[seg] > 0; i++)
+    if (map[s.logical[i]] == base + 1 + i)
+      {
+        block_read (disk, base + 1 + i, buf);
+        append (s.logical[i], buf);
+      }
+  ASSERT (seg_live[seg] == 0);
+}
+
+/* Cleans the emptiest segments until TARGET segments are free
+   or about to be, then checkpoints to free them. */
+static void
+clean (size_t target)
+{
+  cleaning = true;
+  while (free_cnt + dead_cnt < target)
+    {
+      size_t i, victim = sb.seg_cnt;
+
+      for (i = 0; i < sb.seg_cnt; i++)
+        if (seg_state[i] == SEG_USED && i != cur_seg
+            && (victim == sb.seg_cnt || seg_live[i] < seg_live[victim]))
+          victim = i;
+      if (victim == sb.seg_cnt || seg_live[victim] == SEG_DATA)
+        break;
+      clean_segment (victim);
+    }
+  if (dead_cnt > 0)
+    checkpoint ();
+  cleaning = false;
+}
+
+/* Finishes the current segment and starts a new one. */
+static void
+next_segment (void)
+{
+  size_t i;
+
+  if (!cleaning && free_cnt <= LFS_RESERVE)
+    {
+      clean (LFS_RESERVE + 1);
+      if (cur_summary.cnt < SEG_DATA)
+        return;
+    }
+
+  flush_segment ();
+  if (seg_live[cur_seg] == 0)
+    set_state (cur_seg, SEG_DEAD);
+  if (free_cnt == 0 && dead_cnt > 0)
+    checkpoint ();
+  if (free_cnt == 0)
+    PANIC ("lfs: no free segments");
+
+  for (i = 0; seg_state[i] != SEG_FREE; i++)
+    continue;
+  set_state (i, SEG_USED);
+  cur_seg = i;
+  memset (&cur_summary, 0, sizeof cur_summary);
+  cur_summary.magic = LFS_MAGIC;
+  cur_summary.seq++;
+  cur_flushed = 0;
+  summary_dirty = true;
+
+  if (free_cnt < LFS_CLEAN_LOW)
+    sema_up (&clean_sema);
+}
+
+/* Sets up the in-memory state for the superblock in SB, with
+   every segment free and an empty map. */
+static void
+setup (void)
+{
+  size_t i;
+
+  map = calloc (map_sectors (), BLOCK_SECTOR_SIZE);
+  seg_live = calloc (sb.seg_cnt, sizeof *seg_live);
+  seg_state = malloc (sb.seg_cnt);
+  cur_data = malloc (SEG_DATA * BLOCK_SECTOR_SIZE);
+  if (map == NULL || seg_live == NULL || seg_state == NULL
+      || cur_data == NULL)
+    PANIC ("lfs: out of memory");
+  for (i = 0; i < sb.seg_cnt; i++)
+    seg_state[i] = SEG_FREE;
+  free_cnt = sb.seg_cnt;
+  dead_cnt = 0;
+}
+
+/* Starts the log in segment SEG, which must be free, with
+   sequence number SEQ. */
+static void
+start_log (size_t seg, uint32_t seq)
+{
+  cur_seg = seg;
+  set_state (seg, SEG_USED);
+  memset (&cur_summary, 0, sizeof cur_summary);
+  cur_summary.magic = LFS_MAGIC;
+  cur_summary.seq = seq;
+  cur_flushed = 0;
+  summary_dirty = true;
+}
+
+/* Lays out an empty log-structured file system on DISK. */
+static void
+format (void)
+{
+  static struct lfs_summary empty;
+  block_sector_t total = block_size (disk);
+  size_t i;
+
+  sb.magic = LFS_MAGIC;
+  sb.cp_sectors = 1 + DIV_ROUND_UP (total * sizeof *map, BLOCK_SECTOR_SIZE);
+  sb.seg_start = 1 + 2 * sb.cp_sectors;
+  sb.seg_cnt = total > sb.seg_start ? (total - sb.seg_start) / SEG_SECTORS : 0;
+  if (sb.seg_cnt < LFS_CLEAN_HIGH)
+    PANIC ("lfs: device too small");
+  sb.logical_cnt = (sb.seg_cnt - LFS_RESERVE) * SEG_DATA / 4 * 3;
+  block_write (disk, 0, &sb);
+
+  /* Stale summaries must not be rolled forward later. */
+  for (i = 0; i < sb.seg_cnt; i++)
+    block_write (disk, seg_base (i), &empty);
+
+  setup ();
+  cp_region = 0;
+  start_log (0, 1);
+  checkpoint ();
+}
+
+/* Loads the newest checkpoint from DISK and rolls forward. */
+static void
+mount (void)
+{
+  static struct lfs_checkpoint cp[2];
+  static struct lfs_summary s;
+  uint32_t *seqs;
+  uint32_t seq, max_seq;
+  size_t i, seg, newer;
+
+  block_read (disk, 0, &sb);
+  setup ();
+
+  /* Newest intact checkpoint. */
+  block_read (disk, 1, &cp[0]);
+  block_read (disk, 1 + sb.cp_sectors, &cp[1]);
+  if (cp[0].magic != LFS_MAGIC && cp[1].magic != LFS_MAGIC)
+    PANIC ("lfs: no checkpoint");
+  newer = (cp[1].magic == LFS_MAGIC
+           && (cp[0].magic != LFS_MAGIC || cp[1].seq > cp[0].seq));
+  block_read_multiple (disk, 1 + newer * sb.cp_sectors + 1, map_sectors (),
+                       map);
+  seq = max_seq = cp[newer].seq;
+
+  /* Roll forward through later segments in the order written. */
+  seqs = calloc (sb.seg_cnt, sizeof *seqs);
+  if (seqs == NULL)
+    PANIC ("lfs: out of memory");
+  for (seg = 0; seg < sb.seg_cnt; seg++)
+    {
+      block_read (disk, seg_base (seg), &s);
+      if (s.magic == LFS_MAGIC && s.seq >= seq && s.cnt <= SEG_DATA)
+        seqs[seg] = s.seq;
+    }
+  for (;;)
+    {
+      size_t next = sb.seg_cnt;
+
+      for (seg = 0; seg < sb.seg_cnt; seg++)
+        if (seqs[seg] != 0
+            && (next == sb.seg_cnt || seqs[seg] < seqs[next]))
+          next = seg;
+      if (next == sb.seg_cnt)
+        break;
+      block_read (disk, seg_base (next), &s);
+      for (i = 0; i < s.cnt; i++)
+        if (s.logical[i] < sb.logical_cnt)
+          map[s.logical[i]] = seg_base (next) + 1 + i;
+      if (s.seq > max_seq)
+        max_seq = s.seq;
+      seqs[next] = 0;
+    }
+  free (seqs);
+
+  /* Rebuild segment usage from the map. */
+  for (i = 0; i < sb.logical_cnt; i++)
+    if (map[i] != 0)
+      seg_live[seg_of (map[i])]++;
+  for (seg = 0; seg < sb.seg_cnt; seg++)
+    if (seg_live[seg] > 0)
+      set_state (seg, SEG_USED);
+  if (free_cnt == 0)
+    PANIC ("lfs: no free segments");
+  for (seg = 0; seg_state[seg] != SEG_FREE; seg++)
+    continue;
+
+  /* Start afresh from a new checkpoint. */
+  cp_region = !newer;
+  start_log (seg, max_seq + 1);
+  checkpoint ();
+}
+
+/* Returns true if DISK holds a log-structured file system. */
+bool
+lfs_detect (struct block *disk_)
+{
+  static struct lfs_super s;
+
+  block_read (disk_, 0, &s);
+  return s.magic == LFS_MAGIC;
+}
+
+/* Returns a virtual block device for the log-structured file
+   system on DISK_, which is first formatted if FORMAT is
+   true. */
+struct block *
+lfs_attach (struct block *disk_, bool format_)
+{
+  static char extra_info[32];
+
+  ASSERT (sizeof (struct lfs_super) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct lfs_checkpoint) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct lfs_summary) == BLOCK_SECTOR_SIZE);
+
+  disk = disk_;
+  lock_init (&lfs_lock);
+  sema_init (&clean_sema, 0);
+  if (format_)
+    format ();
+  else
+    mount ();
+
+  thread_create ("lfs-cleaner", PRI_DEFAULT, cleaner_thread, NULL);
+  snprintf (extra_info, sizeof extra_info, "log-structured on %s",
+            block_name (disk));
+  return block_register ("lfs", BLOCK_FILESYS, extra_info, sb.logical_cnt,
+                         &lfs_operations, NULL);
+}
+
+/* Writes everything out and checkpoints, if the log-structured
+   layer is in use. */
+void
+lfs_done (void)
+{
+  if (disk == NULL)
+    return;
+  lock_acquire (&lfs_lock);
+  checkpoint ();
+  lock_release (&lfs_lock);
+}
+
+/* Cleans in the background whenever free segments run low. */
+static void
+cleaner_thread (void *aux UNUSED)
+{
+  /* Not idle, even though cleaning is background work: it runs
+     under lfs_lock, which every read and write of the file
+     system needs, so holding its I/O back would hold back them
+     all. */
+  block_set_ioprio (BLOCK_IOPRIO_BE);
+  for (;;)
+    {
+      sema_down (&clean_sema);
+      lock_acquire (&lfs_lock);
+      if (free_cnt < LFS_CLEAN_LOW && !cleaning)
+        clean (LFS_CLEAN_HIGH);
+      lock_release (&lfs_lock);
+    }
+}
+
+/* Reads logical SECTOR into BUFFER. */
+static void
+lfs_read (void *aux UNUSED, block_sector_t sector, void *buffer)
+{
+  block_sector_t phys;
+
+  lock_acquire (&lfs_lock);
+  phys = map[sector];
+  if (phys == 0)
+    memset (buffer, 0, BLOCK_SECTOR_SIZE);
+  else if (seg_of (phys) == cur_seg)
+    memcpy (buffer, cur_data + slot_of (phys) * BLOCK_SECTOR_SIZE,
+            BLOCK_SECTOR_SIZE);
+  else
+    block_read (disk, phys, buffer);
+  lock_release (&lfs_lock);
+}
+
+/* Appends BUFFER to the log as the new contents of logical
+   SECTOR. */
+static void
+lfs_write (void *aux UNUSED, block_sector_t sector, const void *buffer)
+{
+  lock_acquire (&lfs_lock);
+  append (sector, buffer);
+  lock_release (&lfs_lock);
+}
+
+/* Writes out the partial current segment. */
+static void
+lfs_flush (void *aux UNUSED)
+{
+  lock_acquire (&lfs_lock);
+  flush_segment ();
+  lock_release (&lfs_lock);
+}
+
+static struct block_operations lfs_operations =
+  {
+    lfs_read,
+    lfs_write,
+    lfs_flush,
+    NULL,
+    NULL
+  };
@@ -0,0 +1,11 @@
+#ifndef FILESYS_LFS_H
+#define FILESYS_LFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+bool lfs_detect (struct block *);
+struct block *lfs_attach (struct block *, bool format);
+void lfs_done (void);
+
+#endif /* filesys/lfs.h */
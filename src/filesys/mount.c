@@ -0,0 +1,142 @@
+#include "filesys/mount.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/filesys.h"
+#include "filesys/tmpfs.h"
+
+/* Maximum number of mounted file systems. */
+#define MOUNT_MAX 8
+
+/* A file system mounted over a directory.  Looking up the
+   directory whose inode is POINT yields the directory whose
+   inode is ROOT instead, and ".." in ROOT yields PARENT, the
+   directory that contains POINT. */
+struct mount
+  {
+    block_sector_t point;               /* Inode covered by the mount. */
+    block_sector_t root;                /* Root of the mounted tree. */
+    block_sector_t parent;              /* Directory containing POINT. */
+  };
+
+/* Disk volumes, the root volume first. */
+static struct volume volumes[VOLUME_MAX];
+static size_t volume_cnt;
+
+/* Mount table.  Volumes and mounts are only added during
+   startup, before any other thread resolves paths, so lookups
+   need no lock. */
+static struct mount mounts[MOUNT_MAX];
+static size_t mount_cnt;
+
+/* Registers the file system on DEVICE as the next volume and
+   returns it, or a null pointer if the table is full or the
+   volumes before it use up every inode number.  The first volume
+   added is the root volume.  Its free map still has to be set
+   up, which decides its size, before the next volume is added. */
+struct volume *
+volume_add (struct block *device, bool journaled)
+{
+  struct volume *vol;
+  block_sector_t base = 0;
+
+  if (volume_cnt >= VOLUME_MAX)
+    return NULL;
+  if (volume_cnt > 0)
+    {
+      struct volume *prev = &volumes[volume_cnt - 1];
+      ASSERT (prev->free_map != NULL);
+      base = ROUND_UP (prev->base + prev->size, fs_cluster_sectors);
+      if (base >= TMPFS_INUMBER_BIT)
+        return NULL;
+    }
+  vol = &volumes[volume_cnt];
+  vol->device = device;
+  vol->base = base;
+  vol->size = 0;
+  vol->journaled = journaled;
+  vol->free_map = NULL;
+  vol->free_map_file = NULL;
+  lock_init (&vol->free_map_lock);
+  volume_cnt++;
+  return vol;
+}
+
+/* Returns volume number INDEX, or a null pointer if there are
+   not that many. */
+struct volume *
+volume_get (size_t index)
+{
+  return index < volume_cnt ? &volumes[index] : NULL;
+}
+
+/* Returns the volume that holds the inode or cached sector
+   INUMBER, or a null pointer for a tmpfs inode. */
+struct volume *
+volume_of (block_sector_t inumber)
+{
+  size_t index;
+
+  if (tmpfs_owns (inumber))
+    return NULL;
+  ASSERT (volume_cnt > 0);
+  for (index = volume_cnt - 1; index > 0; index--)
+    if (inumber >= volumes[index].base)
+      break;
+  ASSERT (volumes[index].size == 0
+          || inumber - volumes[index].base < volumes[index].size);
+  return &volumes[index];
+}
+
+/* Mounts the directory whose inode is ROOT over the directory
+   whose inode is POINT, which is in the directory PARENT.
+   Returns true if successful, false if POINT is already covered
+   or the table is full. */
+bool
+mount_add (block_sector_t point, block_sector_t root, block_sector_t parent)
+{
+  if (mount_cnt >= MOUNT_MAX || mount_is_point (point))
+    return false;
+  mounts[mount_cnt].point = point;
+  mounts[mount_cnt].root = root;
+  mounts[mount_cnt].parent = parent;
+  mount_cnt++;
+  return true;
+}
+
+/* Returns the inode that a lookup arriving at INUMBER should
+   use: the root of the file system mounted there, if any, or
+   INUMBER itself. */
+block_sector_t
+mount_resolve (block_sector_t inumber)
+{
+  size_t i;
+
+  for (i = 0; i < mount_cnt; i++)
+    if (mounts[i].point == inumber)
+      return mounts[i].root;
+  return inumber;
+}
+
+/* Returns true if a file system is mounted over INUMBER. */
+bool
+mount_is_point (block_sector_t inumber)
+{
+  return mount_resolve (inumber) != inumber;
+}
+
+/* If ROOT is the root of a mounted file system, stores the
+   directory that ".." leads to from it into *PARENT and returns
+   true.  Otherwise returns false. */
+bool
+mount_parent (block_sector_t root, block_sector_t *parent)
+{
+  size_t i;
+
+  for (i = 0; i < mount_cnt; i++)
+    if (mounts[i].root == root)
+      {
+        *parent = mounts[i].parent;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,44 @@
+#ifndef FILESYS_MOUNT_H
+#define FILESYS_MOUNT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+
+/* Inode numbers, and buffer cache keys, on a disk volume are
+   its local sector numbers plus its base.  The root volume comes
+   first, at base 0, so its inode numbers are plain sector
+   numbers, and each later volume's base follows the sectors of
+   the one before.  Between them the volumes may use every number
+   below bit 31, which belongs to tmpfs (see filesys/tmpfs.h). */
+#define VOLUME_MAX 8
+
+struct bitmap;
+struct file;
+
+/* A Pintos file system on a block device.  Every volume uses
+   fs_cluster_sectors, since buffer cache entries are sized for
+   it. */
+struct volume
+  {
+    struct block *device;               /* Device it lives on. */
+    block_sector_t base;                /* Inode number of sector 0. */
+    block_sector_t size;                /* Sectors it uses. */
+    bool journaled;                     /* Metadata goes to the journal? */
+    struct bitmap *free_map;            /* One bit per cluster. */
+    struct file *free_map_file;         /* Free map file. */
+    struct lock free_map_lock;          /* Protects the two above. */
+  };
+
+struct volume *volume_add (struct block *, bool journaled);
+struct volume *volume_get (size_t index);
+struct volume *volume_of (block_sector_t inumber);
+
+bool mount_add (block_sector_t point, block_sector_t root,
+                block_sector_t parent);
+block_sector_t mount_resolve (block_sector_t inumber);
+bool mount_is_point (block_sector_t inumber);
+bool mount_parent (block_sector_t root, block_sector_t *parent);
+
+#endif /* filesys/mount.h */
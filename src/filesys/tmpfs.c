@@ -0,0 +1,323 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A memory-only file system.
+
+   Each tmpfs inode is a node holding its type, its length, and
+   an array of pointers to the pages of its contents.  A null
+   page pointer is a hole that reads as zeros, so growing a file
+   costs nothing until its new bytes are written.  Nothing is
+   ever written to a block device, and everything is lost at
+   shutdown.
+
+   The inode layer (filesys/inode.c) passes reads and writes of
+   tmpfs inodes here instead of to the buffer cache.  Directories
+   keep the ordinary entry format on top of that, so path
+   resolution, the dentry cache and readdir work unchanged. */
+
+/* A tmpfs inode. */
+struct tmpfs_node
+  {
+    struct hash_elem elem;              /* Element in nodes. */
+    block_sector_t inumber;             /* Inode number. */
+    bool is_dir;                        /* Directory or ordinary file? */
+    off_t length;                       /* File size in bytes. */
+    size_t page_cnt;                    /* Number of elements in pages. */
+    uint8_t **pages;                    /* Contents, null for a hole. */
+  };
+
+/* Every tmpfs inode, by inode number, and the number to hand out
+   next, without TMPFS_INUMBER_BIT. */
+static struct hash nodes;
+static block_sector_t next_inumber;
+
+/* Protects the above and the contents of every node. */
+static struct lock tmpfs_lock;
+
+static hash_hash_func node_hash;
+static hash_less_func node_less;
+
+/* Initializes tmpfs. */
+void
+tmpfs_init (void)
+{
+  hash_init (&nodes, node_hash, node_less, NULL);
+  next_inumber = 0;
+  lock_init (&tmpfs_lock);
+}
+
+/* Returns the node for INUMBER.  Must be called with tmpfs_lock
+   held. */
+static struct tmpfs_node *
+find (block_sector_t inumber)
+{
+  struct tmpfs_node key;
+  struct hash_elem *e;
+
+  key.inumber = inumber;
+  e = hash_find (&nodes, &key.elem);
+  return e != NULL ? hash_entry (e, struct tmpfs_node, elem) : NULL;
+}
+
+/* Creates an empty tmpfs inode and stores its number into
+   *INUMBER.  Returns true if successful, false if out of
+   memory or inode numbers. */
+bool
+tmpfs_allocate (block_sector_t *inumber)
+{
+  struct tmpfs_node *node = calloc (1, sizeof *node);
+  if (node == NULL)
+    return false;
+
+  lock_acquire (&tmpfs_lock);
+  if (next_inumber & TMPFS_INUMBER_BIT)
+    {
+      lock_release (&tmpfs_lock);
+      free (node);
+      return false;
+    }
+  node->inumber = next_inumber++ | TMPFS_INUMBER_BIT;
+  hash_insert (&nodes, &node->elem);
+  lock_release (&tmpfs_lock);
+
+  *inumber = node->inumber;
+  return true;
+}
+
+/* Makes the tmpfs inode INUMBER a directory if IS_DIR is true
+   or an ordinary file otherwise, LENGTH bytes long and all
+   zeros.  Returns true if successful, false if no such inode
+   exists. */
+bool
+tmpfs_setup (block_sector_t inumber, off_t length, bool is_dir)
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = find (inumber);
+  if (node != NULL)
+    {
+      node->is_dir = is_dir;
+      node->length = length;
+    }
+  lock_release (&tmpfs_lock);
+  return node != NULL;
+}
+
+/* Frees the pages of NODE from page index FIRST onward. Must be
+   called with tmpfs_lock held. */
+static void
+free_pages (struct tmpfs_node *node, size_t first)
+{
+  size_t i;
+
+  for (i = first; i < node->page_cnt; i++)
+    if (node->pages[i] != NULL)
+      {
+        palloc_free_page (node->pages[i]);
+        node->pages[i] = NULL;
+      }
+}
+
+/* Destroys the tmpfs inode INUMBER and frees its memory.  It
+   must not be open. */
+void
+tmpfs_release (block_sector_t inumber)
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = find (inumber);
+  if (node != NULL)
+    {
+      hash_delete (&nodes, &node->elem);
+      free_pages (node, 0);
+    }
+  lock_release (&tmpfs_lock);
+
+  if (node != NULL)
+    {
+      free (node->pages);
+      free (node);
+    }
+}
+
+/* Returns the node for tmpfs inode INUMBER, or a null pointer if
+   there is none.  The node stays valid until released. */
+struct tmpfs_node *
+tmpfs_lookup (block_sector_t inumber)
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = find (inumber);
+  lock_release (&tmpfs_lock);
+  return node;
+}
+
+/* Returns true if NODE is a directory. */
+bool
+tmpfs_is_dir (const struct tmpfs_node *node)
+{
+  return node->is_dir;
+}
+
+/* Returns the length of NODE in bytes. */
+off_t
+tmpfs_length (const struct tmpfs_node *node)
+{
+  return node->length;
+}
+
+/* Reads SIZE bytes from NODE into BUFFER, starting at OFFSET.
+   Returns the number of bytes read, which is less than SIZE only
+   at end of file. */
+off_t
+tmpfs_read (struct tmpfs_node *node, void *buffer_, off_t size, off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  lock_acquire (&tmpfs_lock);
+  while (size > 0 && offset < node->length)
+    {
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
+      off_t inode_left = node->length - offset;
+      int page_left = PGSIZE - page_ofs;
+      int chunk_size = size < inode_left ? size : inode_left;
+      if (chunk_size > page_left)
+        chunk_size = page_left;
+
+      if (page_idx < node->page_cnt && node->pages[page_idx] != NULL)
+        memcpy (buffer + bytes_read, node->pages[page_idx] + page_ofs,
+                chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  lock_release (&tmpfs_lock);
+  return bytes_read;
+}
+
+/* Makes NODE's page array long enough for PAGE_CNT pages.
+   Must be called with tmpfs_lock held.  Returns true if
+   successful, false if out of memory. */
+static bool
+reserve (struct tmpfs_node *node, size_t page_cnt)
+{
+  uint8_t **pages;
+
+  if (page_cnt <= node->page_cnt)
+    return true;
+
+  pages = realloc (node->pages, page_cnt * sizeof *pages);
+  if (pages == NULL)
+    return false;
+  memset (pages + node->page_cnt, 0,
+          (page_cnt - node->page_cnt) * sizeof *pages);
+  node->pages = pages;
+  node->page_cnt = page_cnt;
+  return true;
+}
+
+/* Writes SIZE bytes from BUFFER into NODE, starting at OFFSET,
+   extending NODE if necessary.  Returns the number of bytes
+   written, which is less than SIZE only if memory runs out. */
+off_t
+tmpfs_write (struct tmpfs_node *node, const void *buffer_, off_t size,
+             off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  lock_acquire (&tmpfs_lock);
+  if (size > 0 && !reserve (node, DIV_ROUND_UP (offset + size, PGSIZE)))
+    size = 0;
+  while (size > 0)
+    {
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
+      int page_left = PGSIZE - page_ofs;
+      int chunk_size = size < page_left ? size : page_left;
+
+      if (node->pages[page_idx] == NULL)
+        {
+          node->pages[page_idx] = palloc_get_page (PAL_ZERO);
+          if (node->pages[page_idx] == NULL)
+            break;
+        }
+      memcpy (node->pages[page_idx] + page_ofs, buffer + bytes_written,
+              chunk_size);
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  if (offset > node->length && bytes_written > 0)
+    node->length = offset;
+  lock_release (&tmpfs_lock);
+  return bytes_written;
+}
+
+/* Shrinks NODE to LENGTH bytes, which must not exceed its
+   current length, freeing pages past the new end. */
+void
+tmpfs_truncate (struct tmpfs_node *node, off_t length)
+{
+  size_t page_idx = length / PGSIZE;
+  int page_ofs = length % PGSIZE;
+
+  ASSERT (length >= 0 && length <= node->length);
+
+  lock_acquire (&tmpfs_lock);
+  if (page_ofs > 0 && page_idx < node->page_cnt
+      && node->pages[page_idx] != NULL)
+    memset (node->pages[page_idx] + page_ofs, 0, PGSIZE - page_ofs);
+  free_pages (node, DIV_ROUND_UP (length, PGSIZE));
+  node->length = length;
+  lock_release (&tmpfs_lock);
+}
+
+/* Grows NODE to LENGTH bytes if it is shorter.  The new bytes
+   are a hole that reads as zeros, so memory is only taken once
+   they are written.  Returns true if successful, false if out
+   of memory. */
+bool
+tmpfs_extend (struct tmpfs_node *node, off_t length)
+{
+  bool success;
+
+  lock_acquire (&tmpfs_lock);
+  success = reserve (node, DIV_ROUND_UP (length, PGSIZE));
+  if (success && length > node->length)
+    node->length = length;
+  lock_release (&tmpfs_lock);
+  return success;
+}
+
+/* Hashes a node by its inode number. */
+static unsigned
+node_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct tmpfs_node, elem)->inumber);
+}
+
+/* Orders nodes by inode number. */
+static bool
+node_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return (hash_entry (a, struct tmpfs_node, elem)->inumber
+          < hash_entry (b, struct tmpfs_node, elem)->inumber);
+}
@@ -0,0 +1,35 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Inode numbers with this bit set name tmpfs inodes, which live
+   only in memory, rather than inode sectors on fs_device. */
+#define TMPFS_INUMBER_BIT 0x80000000u
+
+/* Returns true if INUMBER names a tmpfs inode. */
+static inline bool
+tmpfs_owns (block_sector_t inumber)
+{
+  return (inumber & TMPFS_INUMBER_BIT) != 0;
+}
+
+struct tmpfs_node;
+
+void tmpfs_init (void);
+bool tmpfs_allocate (block_sector_t *inumber);
+bool tmpfs_setup (block_sector_t inumber, off_t length, bool is_dir);
+void tmpfs_release (block_sector_t inumber);
+struct tmpfs_node *tmpfs_lookup (block_sector_t inumber);
+
+bool tmpfs_is_dir (const struct tmpfs_node *);
+off_t tmpfs_length (const struct tmpfs_node *);
+off_t tmpfs_read (struct tmpfs_node *, void *, off_t size, off_t offset);
+off_t tmpfs_write (struct tmpfs_node *, const void *, off_t size,
+                   off_t offset);
+void tmpfs_truncate (struct tmpfs_node *, off_t length);
+bool tmpfs_extend (struct tmpfs_node *, off_t length);
+
+#endif /* filesys/tmpfs.h */
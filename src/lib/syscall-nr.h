@@ -28,7 +28,20 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_READDIRPLUS,            /* Reads directory entries with attributes. */
+    SYS_OPENAT,                 /* Opens a file relative to a directory fd. */
+    SYS_CREATEAT,               /* Creates a file relative to a directory fd. */
+    SYS_MKDIRAT,                /* Creates a directory relative to a dir fd. */
+    SYS_UNLINKAT,               /* Deletes a file relative to a directory fd. */
+    SYS_FSYNC,                  /* Makes a file's updates durable. */
+    SYS_DIRECTIO,               /* Bypasses the buffer cache for a file. */
+    SYS_DEFRAG,                 /* Makes a file's data contiguous. */
+    SYS_ADVISE,                 /* Hints how a file will be accessed. */
+    SYS_FALLOCATE,              /* Preallocates space for a file. */
+    SYS_IOPRIO                  /* Sets the I/O class of a process. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +201,69 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+readdirplus (int fd, struct readdir_entry *entries, unsigned cnt)
+{
+  return syscall3 (SYS_READDIRPLUS, fd, entries, cnt);
+}
+
+int
+openat (int dirfd, const char *file)
+{
+  return syscall2 (SYS_OPENAT, dirfd, file);
+}
+
+bool
+createat (int dirfd, const char *file, unsigned initial_size)
+{
+  return syscall3 (SYS_CREATEAT, dirfd, file, initial_size);
+}
+
+bool
+mkdirat (int dirfd, const char *dir)
+{
+  return syscall2 (SYS_MKDIRAT, dirfd, dir);
+}
+
+bool
+unlinkat (int dirfd, const char *file)
+{
+  return syscall2 (SYS_UNLINKAT, dirfd, file);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+bool
+directio (int fd, bool enable)
+{
+  return syscall2 (SYS_DIRECTIO, fd, (int) enable);
+}
+
+bool
+defrag (int fd, struct defrag_stats *stats)
+{
+  return syscall2 (SYS_DEFRAG, fd, stats);
+}
+
+bool
+advise (int fd, unsigned offset, unsigned length, int advice)
+{
+  return syscall4 (SYS_ADVISE, fd, offset, length, advice);
+}
+
+bool
+fallocate (int fd, unsigned offset, unsigned length)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+int
+ioprio (int ioclass)
+{
+  return syscall1 (SYS_IOPRIO, ioclass);
+}
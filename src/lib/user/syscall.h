@@ -15,6 +15,35 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry returned by readdirplus(). */
+struct readdir_entry
+  {
+    char name[READDIR_MAX_LEN + 1];     /* Null terminated file name. */
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Directory or ordinary file? */
+    int size;                           /* File size in bytes. */
+  };
+
+/* Fragmentation of a file, as reported by defrag(). */
+struct defrag_stats
+  {
+    int clusters;                       /* Data clusters in the file. */
+    int extents_before;                 /* Contiguous runs beforehand. */
+    int extents_after;                  /* Contiguous runs afterward. */
+  };
+
+/* Access pattern hints for advise(). */
+#define ADVISE_NORMAL 0         /* No particular pattern. */
+#define ADVISE_SEQUENTIAL 1     /* Read front to back, once. */
+#define ADVISE_RANDOM 2         /* Read in no particular order. */
+#define ADVISE_WILLNEED 3       /* Range will be read soon. */
+#define ADVISE_DONTNEED 4       /* Range won't be read again soon. */
+
+/* I/O classes for ioprio(). */
+#define IOPRIO_RT 0             /* Ahead of everything else. */
+#define IOPRIO_BE 1             /* The default. */
+#define IOPRIO_IDLE 2           /* Only when the disk is otherwise idle. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +74,17 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int readdirplus (int fd, struct readdir_entry *, unsigned cnt);
+int openat (int dirfd, const char *file);
+bool createat (int dirfd, const char *file, unsigned initial_size);
+bool mkdirat (int dirfd, const char *dir);
+bool unlinkat (int dirfd, const char *file);
+bool fsync (int fd);
+bool directio (int fd, bool enable);
+bool defrag (int fd, struct defrag_stats *);
+bool advise (int fd, unsigned offset, unsigned length, int advice);
+bool fallocate (int fd, unsigned offset, unsigned length);
+int ioprio (int ioclass);
+
 #endif /* lib/user/syscall.h */
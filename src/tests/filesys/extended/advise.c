@@ -0,0 +1,84 @@
+/* Gives each access hint for a file and checks that reads see
+   the file's contents regardless, including data written after
+   the cached copy was dropped and a dirty cluster that
+   ADVISE_DONTNEED must keep. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 16384
+#define CHUNK_SIZE 512
+#define PATCH_OFS 4096
+#define PATCH_SIZE 512
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+/* Reads all of FD from the start CHUNK_SIZE bytes at a time and
+   compares it against BUF. */
+static void
+read_sequential (int fd, const char *what)
+{
+  size_t ofs;
+
+  seek (fd, 0);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    if (read (fd, buf2 + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("read \"data\" at offset %zu (%s)", ofs, what);
+  compare_bytes (buf2, buf, FILE_SIZE, 0, "data");
+}
+
+void
+test_main (void) 
+{
+  size_t i;
+  int fd;
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+
+  CHECK (advise (fd, 0, 0, ADVISE_SEQUENTIAL), "advise sequential");
+  read_sequential (fd, "sequential");
+  msg ("read \"data\" sequentially");
+
+  CHECK (advise (fd, 0, 0, ADVISE_RANDOM), "advise random");
+  for (i = 0; i < FILE_SIZE / CHUNK_SIZE; i++)
+    {
+      size_t ofs = (i * 7 % (FILE_SIZE / CHUNK_SIZE)) * CHUNK_SIZE;
+      seek (fd, ofs);
+      if (read (fd, buf2, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read \"data\" at offset %zu (random)", ofs);
+      compare_bytes (buf2, buf + ofs, CHUNK_SIZE, ofs, "data");
+    }
+  msg ("read \"data\" randomly");
+
+  CHECK (advise (fd, 0, 0, ADVISE_NORMAL), "advise normal");
+  CHECK (advise (fd, FILE_SIZE / 2, FILE_SIZE / 2, ADVISE_WILLNEED),
+         "advise willneed");
+  read_sequential (fd, "willneed");
+  msg ("read \"data\" after willneed");
+
+  CHECK (advise (fd, 0, 0, ADVISE_DONTNEED), "advise dontneed");
+  read_sequential (fd, "dontneed");
+  msg ("read \"data\" after dontneed");
+
+  random_bytes (buf + PATCH_OFS, PATCH_SIZE);
+  seek (fd, PATCH_OFS);
+  CHECK (write (fd, buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "write \"data\" again");
+  CHECK (advise (fd, PATCH_OFS, PATCH_SIZE, ADVISE_DONTNEED),
+         "advise dontneed on written data");
+  read_sequential (fd, "written");
+  msg ("read \"data\" after write");
+
+  CHECK (!advise (fd, 0, 0, 42), "advise with bad hint fails");
+  CHECK (!advise (fd + 1, 0, 0, ADVISE_WILLNEED), "advise bad fd fails");
+
+  msg ("close \"data\"");
+  close (fd);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(advise) begin
+(advise) create "data"
+(advise) open "data"
+(advise) write "data"
+(advise) advise sequential
+(advise) read "data" sequentially
+(advise) advise random
+(advise) read "data" randomly
+(advise) advise normal
+(advise) advise willneed
+(advise) read "data" after willneed
+(advise) advise dontneed
+(advise) read "data" after dontneed
+(advise) write "data" again
+(advise) advise dontneed on written data
+(advise) read "data" after write
+(advise) advise with bad hint fails
+(advise) advise bad fd fails
+(advise) close "data"
+(advise) end
+advise: exit(0)
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($big) = random_bytes (600000);
+my ($pre) = "\0" x 560000;
+substr ($pre, 540000, 1000) = random_bytes (1000);
+check_archive ({'big' => [$big], 'pre' => [$pre]});
+pass;
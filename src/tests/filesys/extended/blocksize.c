@@ -0,0 +1,44 @@
+/* Runs on a file system formatted with 4 kB clusters.  Grows a
+   file past the clusters its inode points to directly, so that
+   it needs an index block, then preallocates another that far
+   and writes into the part its index block maps. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BIG_SIZE 600000
+#define PRE_SIZE 560000
+#define PATCH_OFS 540000
+#define PATCH_SIZE 1000
+
+static char buf[BIG_SIZE];
+
+static size_t
+return_block_size (void) 
+{
+  return 5000;
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  seq_test ("big", buf, BIG_SIZE, 0, return_block_size, NULL);
+
+  CHECK (create ("pre", 0), "create \"pre\"");
+  CHECK ((fd = open ("pre")) > 1, "open \"pre\"");
+  CHECK (fallocate (fd, 0, PRE_SIZE), "fallocate \"pre\"");
+  memset (buf, 0, PRE_SIZE);
+  random_bytes (buf + PATCH_OFS, PATCH_SIZE);
+  seek (fd, PATCH_OFS);
+  CHECK (write (fd, buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "write into preallocated space");
+  msg ("close \"pre\"");
+  close (fd);
+  check_file ("pre", buf, PRE_SIZE);
+}
@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($fs) = map (/^(\S+) \(filesys\): /, @output);
+fail "no statistics for the file system device\n" if !defined $fs;
+my ($read, $written, $requests)
+  = map (/^\Q$fs\E: (\d+) bytes read, (\d+) bytes written in (\d+) requests/,
+         @output);
+fail "no transfer counts for $fs\n" if !defined $requests;
+fail "$fs moved 4 kB clusters mostly a sector at a time: "
+  . ($read + $written) / 512 . " sectors in $requests requests\n"
+  if 2 * ($read + $written) < 3 * 512 * $requests;
+check_expected ([<<'EOF']);
+(blocksize) begin
+(blocksize) create "big"
+(blocksize) open "big"
+(blocksize) writing "big"
+(blocksize) close "big"
+(blocksize) open "big" for verification
+(blocksize) verified contents of "big"
+(blocksize) close "big"
+(blocksize) create "pre"
+(blocksize) open "pre"
+(blocksize) fallocate "pre"
+(blocksize) write into preallocated space
+(blocksize) close "pre"
+(blocksize) open "pre" for verification
+(blocksize) verified contents of "pre"
+(blocksize) close "pre"
+(blocksize) end
+blocksize: exit(0)
+EOF
+pass;
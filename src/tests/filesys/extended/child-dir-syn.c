@@ -0,0 +1,37 @@
+/* Child process for dir-syn-create.
+   Creates a directory of its own and fills it with files, while
+   also adding files to a directory shared with the other
+   children, which are doing the same at the same time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/dir-syn-create.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-dir-syn";
+
+int
+main (int argc, const char *argv[]) 
+{
+  char dir[16], name[32];
+  int child_idx;
+  int i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  snprintf (dir, sizeof dir, "d%d", child_idx);
+  CHECK (mkdir (dir), "mkdir \"%s\"", dir);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      snprintf (name, sizeof name, "%s/c%d-%d", shared_dir, child_idx, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+
+  return child_idx;
+}
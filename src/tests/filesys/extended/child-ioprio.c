@@ -0,0 +1,45 @@
+/* Child process for ioprio-sched.
+   Reads "data" with direct I/O, a chunk at a time, RT_PASSES
+   times if it is in the real-time class or IDLE_PASSES times if
+   it is idle, checking it each time. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/ioprio-sched.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-ioprio";
+
+static char buf1[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int passes;
+  int fd;
+  int i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  passes = ioprio (-1) == IOPRIO_IDLE ? IDLE_PASSES : RT_PASSES;
+  random_bytes (buf1, sizeof buf1);
+
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (directio (fd, true), "directio \"data\"");
+  for (i = 0; i < passes; i++)
+    {
+      size_t ofs;
+
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+        CHECK (read (fd, buf2 + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+               "read %d bytes at offset %zu in \"data\"", CHUNK_SIZE, ofs);
+      compare_bytes (buf2, buf1, FILE_SIZE, 0, "data");
+    }
+  close (fd);
+
+  return atoi (argv[1]);
+}
@@ -0,0 +1,64 @@
+/* Child process for syn-direct.
+   Reads the file our parent wrote for us with direct I/O, one
+   chunk at a time, then writes the same data back a chunk at a
+   time from the end to the beginning and reads it again. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-direct.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-direct";
+
+static char buf1[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+/* Reads all of FD, FILE_NAME, a chunk at a time, and checks it
+   against buf1. */
+static void
+read_chunks (int fd, const char *file_name) 
+{
+  size_t ofs;
+
+  seek (fd, 0);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    CHECK (read (fd, buf2 + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+           "read %d bytes at offset %zu in \"%s\"",
+           CHUNK_SIZE, ofs, file_name);
+  compare_bytes (buf2, buf1, FILE_SIZE, 0, file_name);
+}
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  size_t i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "data%d", child_idx);
+
+  random_init (child_idx + 1);
+  random_bytes (buf1, sizeof buf1);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (directio (fd, true), "directio \"%s\"", file_name);
+  read_chunks (fd, file_name);
+  for (i = CHUNK_CNT; i-- > 0; )
+    {
+      seek (fd, i * CHUNK_SIZE);
+      CHECK (write (fd, buf1 + i * CHUNK_SIZE, CHUNK_SIZE) == CHUNK_SIZE,
+             "write %d bytes at offset %zu in \"%s\"",
+             CHUNK_SIZE, i * CHUNK_SIZE, file_name);
+    }
+  read_chunks (fd, file_name);
+  close (fd);
+
+  return child_idx;
+}
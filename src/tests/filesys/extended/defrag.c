@@ -0,0 +1,54 @@
+/* Grows two files in alternation so that their clusters
+   interleave on disk, defragments one of them, and checks that
+   it ends up in one contiguous run with its data intact. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 4096
+#define CHUNK_SIZE 512
+
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  struct defrag_stats stats;
+  int fd_a, fd_b;
+  size_t ofs;
+
+  random_bytes (buf_a, sizeof buf_a);
+  random_bytes (buf_b, sizeof buf_b);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+
+  msg ("write \"a\" and \"b\" in alternation");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      if (write (fd_a, buf_a + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write %zu bytes at offset %zu in \"a\" failed",
+              (size_t) CHUNK_SIZE, ofs);
+      if (write (fd_b, buf_b + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write %zu bytes at offset %zu in \"b\" failed",
+              (size_t) CHUNK_SIZE, ofs);
+    }
+
+  CHECK (defrag (fd_a, &stats), "defrag \"a\"");
+  if (stats.extents_before < 2)
+    fail ("\"a\" was in %d extents before defrag", stats.extents_before);
+  if (stats.extents_after != 1)
+    fail ("\"a\" is in %d extents after defrag", stats.extents_after);
+
+  msg ("close \"a\"");
+  close (fd_a);
+  msg ("close \"b\"");
+  close (fd_b);
+  check_file ("a", buf_a, sizeof buf_a);
+  check_file ("b", buf_b, sizeof buf_b);
+}
@@ -0,0 +1,25 @@
+/* Creates, opens and removes files relative to a directory
+   file descriptor with the *at() system calls. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int dir_fd, fd;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK ((dir_fd = open ("a")) > 1, "open \"a\"");
+  CHECK (createat (dir_fd, "b", 512), "createat \"b\"");
+  CHECK (mkdirat (dir_fd, "c"), "mkdirat \"c\"");
+  CHECK (createat (dir_fd, "c/d", 0), "createat \"c/d\"");
+  CHECK ((fd = openat (dir_fd, "b")) > 1, "openat \"b\"");
+  CHECK (filesize (fd) == 512, "filesize \"b\"");
+  close (fd);
+  CHECK (unlinkat (dir_fd, "c/d"), "unlinkat \"c/d\"");
+  CHECK (unlinkat (dir_fd, "c"), "unlinkat \"c\"");
+  CHECK (open ("a/c") == -1, "open \"a/c\" (must return -1)");
+  CHECK (openat (dir_fd, "/a/b") > 1, "openat \"/a/b\"");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-at) begin
+(dir-at) mkdir "a"
+(dir-at) open "a"
+(dir-at) createat "b"
+(dir-at) mkdirat "c"
+(dir-at) createat "c/d"
+(dir-at) openat "b"
+(dir-at) filesize "b"
+(dir-at) unlinkat "c/d"
+(dir-at) unlinkat "c"
+(dir-at) open "a/c" (must return -1)
+(dir-at) openat "/a/b"
+(dir-at) end
+dir-at: exit(0)
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($fs) = {'big' => [random_bytes (65536)]};
+$fs->{'d'}{"f$_"} = [] foreach grep ($_ % 5 == 0, 0...6499);
+check_archive ($fs);
+pass;
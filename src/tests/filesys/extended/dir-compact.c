@@ -0,0 +1,77 @@
+/* Grows a directory into its doubly indirect block, then removes
+   enough of its entries that it is compacted back down into its
+   direct blocks.  Writes a file, which may reuse the freed
+   blocks, and checks that the file and the entries left in the
+   directory are both intact. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Enough entries, at 20 bytes each, to need more than the 251
+   sectors of a directory's direct and indirect blocks. */
+#define FILE_CNT 6500
+
+/* Every KEEP'th file survives. */
+#define KEEP 5
+
+static char buf[65536];
+static bool seen[FILE_CNT];
+
+static size_t
+return_block_size (void)
+{
+  return 4096;
+}
+
+void
+test_main (void)
+{
+  char name[READDIR_MAX_LEN + 1];
+  char file_name[32];
+  size_t i, cnt;
+  int fd;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+
+  msg ("creating %d files in \"d\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "d/f%zu", i);
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed", file_name);
+    }
+
+  msg ("removing all but every %dth file", KEEP);
+  for (i = 0; i < FILE_CNT; i++)
+    if (i % KEEP != 0)
+      {
+        snprintf (file_name, sizeof file_name, "d/f%zu", i);
+        if (!remove (file_name))
+          fail ("remove \"%s\" failed", file_name);
+      }
+
+  seq_test ("big", buf, sizeof buf, 0, return_block_size, NULL);
+
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+  msg ("reading \"d\"");
+  cnt = 0;
+  while (readdir (fd, name))
+    {
+      i = atoi (name + 1);
+      snprintf (file_name, sizeof file_name, "f%zu", i);
+      if (strcmp (name, file_name) || i >= FILE_CNT || i % KEEP != 0
+          || seen[i])
+        fail ("unexpected entry \"%s\" in \"d\"", name);
+      seen[i] = true;
+      cnt++;
+    }
+  if (cnt != FILE_CNT / KEEP)
+    fail ("\"d\" has %zu entries instead of %d", cnt, FILE_CNT / KEEP);
+  msg ("close \"d\"");
+  close (fd);
+}
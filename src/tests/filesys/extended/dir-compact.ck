@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-compact) begin
+(dir-compact) mkdir "d"
+(dir-compact) creating 6500 files in "d"
+(dir-compact) removing all but every 5th file
+(dir-compact) create "big"
+(dir-compact) open "big"
+(dir-compact) writing "big"
+(dir-compact) close "big"
+(dir-compact) open "big" for verification
+(dir-compact) verified contents of "big"
+(dir-compact) close "big"
+(dir-compact) open "d"
+(dir-compact) reading "d"
+(dir-compact) close "d"
+(dir-compact) end
+EOF
+pass;
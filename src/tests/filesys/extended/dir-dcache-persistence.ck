@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs) = {'a' => {}, 'b' => {}};
+$fs->{'b'}{"f$_"} = ["\0" x $_] foreach grep ($_ % 2 == 1, 0...299);
+check_archive ($fs);
+pass;
@@ -0,0 +1,84 @@
+/* Looks up names before and after they are created and removed,
+   so that stale positive or negative entries in the dentry cache
+   would give wrong answers, including after a directory is
+   removed and another takes its place.  Then looks up more
+   names than the cache holds, twice over. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* More names than the dentry cache remembers. */
+#define FILE_CNT 300
+
+static int inumbers[FILE_CNT];
+
+void
+test_main (void) 
+{
+  char file_name[32];
+  int fd;
+  size_t i;
+
+  CHECK (open ("a/f") == -1, "open \"a/f\" (must return -1)");
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (open ("a/f") == -1, "open \"a/f\" (must return -1)");
+  CHECK (create ("a/f", 0), "create \"a/f\"");
+  CHECK ((fd = open ("a/f")) > 1, "open \"a/f\"");
+  close (fd);
+  CHECK (remove ("a/f"), "remove \"a/f\"");
+  CHECK (open ("a/f") == -1, "open \"a/f\" (must return -1)");
+  CHECK (create ("a/g", 0), "create \"a/g\"");
+  CHECK (remove ("a/g"), "remove \"a/g\"");
+  CHECK (remove ("a"), "remove \"a\"");
+  CHECK (open ("a") == -1, "open \"a\" (must return -1)");
+
+  /* "b" may well get the sector "a" had. */
+  CHECK (mkdir ("b"), "mkdir \"b\"");
+  CHECK (open ("b/g") == -1, "open \"b/g\" (must return -1)");
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (open ("a/g") == -1, "open \"a/g\" (must return -1)");
+
+  msg ("creating %d files in \"b\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "b/f%zu", i);
+      if (!create (file_name, i))
+        fail ("create \"%s\" failed", file_name);
+    }
+
+  msg ("opening them twice");
+  for (i = 0; i < 2 * FILE_CNT; i++)
+    {
+      size_t n = i % FILE_CNT;
+
+      snprintf (file_name, sizeof file_name, "b/f%zu", n);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed", file_name);
+      if (filesize (fd) != (int) n)
+        fail ("\"%s\" is %d bytes long, not %zu", file_name, filesize (fd), n);
+      if (i < FILE_CNT)
+        inumbers[n] = inumber (fd);
+      else if (inumber (fd) != inumbers[n])
+        fail ("\"%s\" changed inode number", file_name);
+      close (fd);
+    }
+
+  msg ("removing every other one");
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      snprintf (file_name, sizeof file_name, "b/f%zu", i);
+      if (!remove (file_name))
+        fail ("remove \"%s\" failed", file_name);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "b/f%zu", i);
+      fd = open (file_name);
+      if ((fd > 1) != (i % 2 == 1))
+        fail ("open \"%s\" returned %d", file_name, fd);
+      if (fd > 1)
+        close (fd);
+    }
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-dcache) begin
+(dir-dcache) open "a/f" (must return -1)
+(dir-dcache) mkdir "a"
+(dir-dcache) open "a/f" (must return -1)
+(dir-dcache) create "a/f"
+(dir-dcache) open "a/f"
+(dir-dcache) remove "a/f"
+(dir-dcache) open "a/f" (must return -1)
+(dir-dcache) create "a/g"
+(dir-dcache) remove "a/g"
+(dir-dcache) remove "a"
+(dir-dcache) open "a" (must return -1)
+(dir-dcache) mkdir "b"
+(dir-dcache) open "b/g" (must return -1)
+(dir-dcache) mkdir "a"
+(dir-dcache) open "a/g" (must return -1)
+(dir-dcache) creating 300 files in "b"
+(dir-dcache) opening them twice
+(dir-dcache) removing every other one
+(dir-dcache) end
+dir-dcache: exit(0)
+EOF
+pass;
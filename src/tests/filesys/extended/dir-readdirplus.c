@@ -0,0 +1,35 @@
+/* Reads a directory's entries and their attributes in one
+   readdirplus() call. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct readdir_entry entries[8];
+  int fd, cnt;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/b", 512), "create \"a/b\"");
+  CHECK (mkdir ("a/c"), "mkdir \"a/c\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+
+  msg ("readdirplus \"a\"");
+  cnt = readdirplus (fd, entries, sizeof entries / sizeof *entries);
+  if (cnt != 2)
+    fail ("readdirplus returned %d entries instead of 2", cnt);
+
+  if (strcmp (entries[0].name, "b") || entries[0].is_dir
+      || entries[0].size != 512)
+    fail ("bad entry for \"b\"");
+  if (strcmp (entries[1].name, "c") || !entries[1].is_dir)
+    fail ("bad entry for \"c\"");
+  if (entries[0].inumber == entries[1].inumber)
+    fail ("\"b\" and \"c\" have the same inumber");
+
+  CHECK (readdirplus (fd, entries, 1) == 0, "readdirplus at end");
+  close (fd);
+}
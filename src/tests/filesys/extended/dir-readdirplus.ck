@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-readdirplus) begin
+(dir-readdirplus) mkdir "a"
+(dir-readdirplus) create "a/b"
+(dir-readdirplus) mkdir "a/c"
+(dir-readdirplus) open "a"
+(dir-readdirplus) readdirplus "a"
+(dir-readdirplus) readdirplus at end
+(dir-readdirplus) end
+dir-readdirplus: exit(0)
+EOF
+pass;
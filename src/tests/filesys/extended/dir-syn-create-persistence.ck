@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'child-dir-syn'} = 'tests/filesys/extended/child-dir-syn';
+for my $child (0...3) {
+    for my $file (0...7) {
+	$fs->{"d$child"}{"f$file"} = [''];
+	$fs->{'shared'}{"c$child-$file"} = [''];
+    }
+}
+check_archive ($fs);
+pass;
@@ -0,0 +1,48 @@
+/* Spawns several child processes that each create files in a
+   directory of their own and in one directory they all share,
+   then checks that no entry was lost or duplicated. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/extended/dir-syn-create.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Returns the number of entries in directory NAME. */
+static int
+count_entries (const char *name)
+{
+  char entry[READDIR_MAX_LEN + 1];
+  int fd, cnt = 0;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  while (readdir (fd, entry))
+    cnt++;
+  close (fd);
+  return cnt;
+}
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char name[16];
+  int i, cnt;
+
+  CHECK (mkdir (shared_dir), "mkdir \"%s\"", shared_dir);
+
+  exec_children ("child-dir-syn", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  cnt = count_entries (shared_dir);
+  if (cnt != CHILD_CNT * FILE_CNT)
+    fail ("\"%s\" has %d entries, expected %d",
+          shared_dir, cnt, CHILD_CNT * FILE_CNT);
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d%d", i);
+      cnt = count_entries (name);
+      if (cnt != FILE_CNT)
+        fail ("\"%s\" has %d entries, expected %d", name, cnt, FILE_CNT);
+    }
+}
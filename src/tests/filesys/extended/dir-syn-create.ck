@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-syn-create) begin
+(dir-syn-create) mkdir "shared"
+(dir-syn-create) exec child 1 of 4: "child-dir-syn 0"
+(dir-syn-create) exec child 2 of 4: "child-dir-syn 1"
+(dir-syn-create) exec child 3 of 4: "child-dir-syn 2"
+(dir-syn-create) exec child 4 of 4: "child-dir-syn 3"
+(dir-syn-create) wait for child 1 of 4 returned 0 (expected 0)
+(dir-syn-create) wait for child 2 of 4 returned 1 (expected 1)
+(dir-syn-create) wait for child 3 of 4 returned 2 (expected 2)
+(dir-syn-create) wait for child 4 of 4 returned 3 (expected 3)
+(dir-syn-create) open "shared"
+(dir-syn-create) open "d0"
+(dir-syn-create) open "d1"
+(dir-syn-create) open "d2"
+(dir-syn-create) open "d3"
+(dir-syn-create) end
+EOF
+pass;
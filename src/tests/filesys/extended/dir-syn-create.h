@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_EXTENDED_DIR_SYN_CREATE_H
+#define TESTS_FILESYS_EXTENDED_DIR_SYN_CREATE_H
+
+#define CHILD_CNT 4
+#define FILE_CNT 8
+static const char shared_dir[] = "shared";
+
+#endif /* tests/filesys/extended/dir-syn-create.h */
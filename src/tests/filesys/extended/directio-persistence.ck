@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (8192);
+substr ($data, 0, 512) = random_bytes (512);
+check_archive ({'data' => [$data]});
+pass;
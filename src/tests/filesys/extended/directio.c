@@ -0,0 +1,48 @@
+/* Writes a file with direct I/O and reads it back through the
+   buffer cache, then writes part of it through the cache and
+   reads it back with direct I/O, checking that both views
+   agree. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 8192
+#define PATCH_SIZE 512
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd, fd2;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (directio (fd, true), "directio \"data\"");
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"data\" directly");
+
+  CHECK ((fd2 = open ("data")) > 1, "open \"data\" again");
+  CHECK (read (fd2, buf2, sizeof buf2) == sizeof buf2,
+         "read \"data\" through cache");
+  compare_bytes (buf2, buf, sizeof buf, 0, "data");
+
+  random_bytes (buf, PATCH_SIZE);
+  seek (fd2, 0);
+  CHECK (write (fd2, buf, PATCH_SIZE) == PATCH_SIZE,
+         "write \"data\" through cache");
+  seek (fd, 0);
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2,
+         "read \"data\" directly");
+  compare_bytes (buf2, buf, sizeof buf, 0, "data");
+
+  msg ("close \"data\"");
+  close (fd);
+  msg ("close \"data\" again");
+  close (fd2);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($failed) = grep (/: DMA failed, /, @output);
+fail "$failed\n" if defined $failed;
+check_expected ([<<'EOF']);
+(directio) begin
+(directio) create "data"
+(directio) open "data"
+(directio) directio "data"
+(directio) write "data" directly
+(directio) open "data" again
+(directio) read "data" through cache
+(directio) write "data" through cache
+(directio) read "data" directly
+(directio) close "data"
+(directio) close "data" again
+(directio) end
+directio: exit(0)
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (100) . ("\0" x 19900);
+substr ($data, 10000, 1000) = random_bytes (1000);
+check_archive ({'data' => [$data]});
+pass;
@@ -0,0 +1,50 @@
+/* Preallocates space past the end of a file, checks that it
+   reads as zeros, then writes into the middle of it and checks
+   that the file reads back as expected. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HEAD_SIZE 100
+#define FILE_SIZE 20000
+#define PATCH_OFS 10000
+#define PATCH_SIZE 1000
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  random_bytes (buf, HEAD_SIZE);
+  CHECK (write (fd, buf, HEAD_SIZE) == HEAD_SIZE, "write \"data\"");
+
+  CHECK (fallocate (fd, 0, FILE_SIZE), "fallocate \"data\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"data\" is %d", FILE_SIZE);
+  seek (fd, 0);
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"data\"");
+  compare_bytes (buf2, buf, FILE_SIZE, 0, "data");
+
+  random_bytes (buf + PATCH_OFS, PATCH_SIZE);
+  seek (fd, PATCH_OFS);
+  CHECK (write (fd, buf + PATCH_OFS, PATCH_SIZE) == PATCH_SIZE,
+         "write into preallocated space");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"data\" is %d", FILE_SIZE);
+  seek (fd, 0);
+  CHECK (read (fd, buf2, FILE_SIZE) == FILE_SIZE, "read \"data\" again");
+  compare_bytes (buf2, buf, FILE_SIZE, 0, "data");
+
+  CHECK (fallocate (fd, 0, HEAD_SIZE), "fallocate within \"data\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"data\" is %d", FILE_SIZE);
+  CHECK (!fallocate (fd + 1, 0, FILE_SIZE), "fallocate bad fd fails");
+
+  msg ("close \"data\"");
+  close (fd);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fallocate) begin
+(fallocate) create "data"
+(fallocate) open "data"
+(fallocate) write "data"
+(fallocate) fallocate "data"
+(fallocate) filesize "data" is 20000
+(fallocate) read "data"
+(fallocate) write into preallocated space
+(fallocate) filesize "data" is 20000
+(fallocate) read "data" again
+(fallocate) fallocate within "data"
+(fallocate) filesize "data" is 20000
+(fallocate) fallocate bad fd fails
+(fallocate) close "data"
+(fallocate) end
+fallocate: exit(0)
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({'data' => [random_bytes (1234)], 'dir' => {}});
+pass;
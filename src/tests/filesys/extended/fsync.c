@@ -0,0 +1,30 @@
+/* Writes a file and creates a directory, making each durable
+   with fsync. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[1234];
+
+void
+test_main (void) 
+{
+  int fd, dir_fd;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  CHECK (fsync (fd), "fsync \"data\"");
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (fsync (dir_fd), "fsync \"dir\"");
+
+  msg ("close \"data\"");
+  close (fd);
+  msg ("close \"dir\"");
+  close (dir_fd);
+}
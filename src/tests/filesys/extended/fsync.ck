@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync) begin
+(fsync) create "data"
+(fsync) open "data"
+(fsync) write "data"
+(fsync) fsync "data"
+(fsync) mkdir "dir"
+(fsync) open "dir"
+(fsync) fsync "dir"
+(fsync) close "data"
+(fsync) close "dir"
+(fsync) end
+fsync: exit(0)
+EOF
+pass;
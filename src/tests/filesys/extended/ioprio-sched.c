@@ -0,0 +1,40 @@
+/* Starts subprocesses in the real-time and idle classes that
+   read the same file with direct I/O at the same time.  The
+   real-time ones make many more requests, but the dispatcher
+   should serve them first, so the idle ones' requests should
+   spend longer in the queue on average, as the statistics
+   printed at shutdown show. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/extended/ioprio-sched.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t rt_children[RT_CHILD_CNT];
+  pid_t idle_children[IDLE_CHILD_CNT];
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  CHECK (fsync (fd), "fsync \"data\"");
+  msg ("close \"data\"");
+  close (fd);
+
+  /* Children start in the class of the process that runs them. */
+  CHECK (ioprio (IOPRIO_RT) == IOPRIO_BE, "ioprio real-time");
+  exec_children ("child-ioprio", rt_children, RT_CHILD_CNT);
+  CHECK (ioprio (IOPRIO_IDLE) == IOPRIO_RT, "ioprio idle");
+  exec_children ("child-ioprio", idle_children, IDLE_CHILD_CNT);
+  CHECK (ioprio (IOPRIO_BE) == IOPRIO_IDLE, "ioprio best-effort");
+
+  wait_children (rt_children, RT_CHILD_CNT);
+  wait_children (idle_children, IDLE_CHILD_CNT);
+}
@@ -0,0 +1,43 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($fs) = map (/^(\S+) \(filesys\): \d+ reads, \d+ writes$/, @output);
+fail "no statistics for the file system device\n" if !defined $fs;
+my ($waits) = map (/^\Q$fs\E: queue wait by class \(us\):(.*)$/, @output);
+fail "no queue wait by class for $fs\n" if !defined $waits;
+my (%avg);
+while ($waits =~ /(\S+) (\d+)\/(\d+)/g) {
+    $avg{$1} = $2 / $3;
+}
+foreach my $class ('realtime', 'idle') {
+    fail "no $class requests on $fs\n" if !defined $avg{$class};
+}
+fail sprintf ("idle requests waited %.0f us on average, no longer "
+              . "than real-time ones at %.0f us\n",
+              $avg{idle}, $avg{realtime})
+  if $avg{idle} <= $avg{realtime};
+check_expected ([<<'EOF']);
+(ioprio-sched) begin
+(ioprio-sched) create "data"
+(ioprio-sched) open "data"
+(ioprio-sched) write "data"
+(ioprio-sched) fsync "data"
+(ioprio-sched) close "data"
+(ioprio-sched) ioprio real-time
+(ioprio-sched) exec child 1 of 2: "child-ioprio 0"
+(ioprio-sched) exec child 2 of 2: "child-ioprio 1"
+(ioprio-sched) ioprio idle
+(ioprio-sched) exec child 1 of 2: "child-ioprio 0"
+(ioprio-sched) exec child 2 of 2: "child-ioprio 1"
+(ioprio-sched) ioprio best-effort
+(ioprio-sched) wait for child 1 of 2 returned 0 (expected 0)
+(ioprio-sched) wait for child 2 of 2 returned 1 (expected 1)
+(ioprio-sched) wait for child 1 of 2 returned 0 (expected 0)
+(ioprio-sched) wait for child 2 of 2 returned 1 (expected 1)
+(ioprio-sched) end
+ioprio-sched: exit(0)
+EOF
+pass;
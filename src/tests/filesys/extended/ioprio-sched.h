@@ -0,0 +1,12 @@
+#ifndef TESTS_FILESYS_EXTENDED_IOPRIO_SCHED_H
+#define TESTS_FILESYS_EXTENDED_IOPRIO_SCHED_H
+
+#define RT_CHILD_CNT 2
+#define IDLE_CHILD_CNT 2
+#define RT_PASSES 8
+#define IDLE_PASSES 1
+#define CHUNK_SIZE 4096
+#define CHUNK_CNT 8
+#define FILE_SIZE (CHUNK_SIZE * CHUNK_CNT)
+
+#endif /* tests/filesys/extended/ioprio-sched.h */
@@ -0,0 +1,41 @@
+/* Moves between the I/O classes, checking what ioprio() reports
+   each time, and checks that a file written in the idle class
+   reads back correctly in the real-time class. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 8192
+
+static char buf[FILE_SIZE];
+static char buf2[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (ioprio (-1) == IOPRIO_BE, "class is best-effort");
+  CHECK (ioprio (IOPRIO_IDLE) == IOPRIO_BE, "ioprio idle");
+  CHECK (ioprio (-1) == IOPRIO_IDLE, "class is idle");
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  CHECK (fsync (fd), "fsync \"data\"");
+
+  CHECK (ioprio (IOPRIO_RT) == IOPRIO_IDLE, "ioprio real-time");
+  seek (fd, 0);
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2, "read \"data\"");
+  compare_bytes (buf2, buf, sizeof buf, 0, "data");
+
+  CHECK (ioprio (3) == -1, "ioprio bad class fails");
+  CHECK (ioprio (-1) == IOPRIO_RT, "class is still real-time");
+  CHECK (ioprio (IOPRIO_BE) == IOPRIO_RT, "ioprio best-effort");
+
+  msg ("close \"data\"");
+  close (fd);
+}
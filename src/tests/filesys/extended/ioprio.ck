@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ioprio) begin
+(ioprio) class is best-effort
+(ioprio) ioprio idle
+(ioprio) class is idle
+(ioprio) create "data"
+(ioprio) open "data"
+(ioprio) write "data"
+(ioprio) fsync "data"
+(ioprio) ioprio real-time
+(ioprio) read "data"
+(ioprio) ioprio bad class fails
+(ioprio) class is still real-time
+(ioprio) ioprio best-effort
+(ioprio) close "data"
+(ioprio) end
+ioprio: exit(0)
+EOF
+pass;
@@ -0,0 +1,6 @@
+/* Grows a file to 23,456 bytes, 1,234 bytes at a time, with the
+   kernel tracing I/O requests, which it saves to the scratch
+   disk at shutdown. */
+
+#define TEST_SIZE 23456
+#include "tests/filesys/extended/grow-seq.inc"
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "trace not saved\n"
+  if !grep (/^iotrace: saved [1-9]\d* requests \(\d+ lost\) to /, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iotrace) begin
+(iotrace) create "testme"
+(iotrace) open "testme"
+(iotrace) writing "testme"
+(iotrace) close "testme"
+(iotrace) open "testme" for verification
+(iotrace) verified contents of "testme"
+(iotrace) close "testme"
+(iotrace) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+random_bytes (102400) foreach 1...47;
+check_archive ({'data' => [random_bytes (102400)]});
+pass;
@@ -0,0 +1,36 @@
+/* Runs on a file system formatted log-structured.  Rewrites a
+   file with fresh data until more has been written than the log
+   holds, so that the cleaner has to reclaim segments, then
+   checks the last version. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Rewriting the file this many times writes more than twice
+   the 2 MB disk. */
+#define FILE_SIZE 102400
+#define PASS_CNT 48
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd, pass;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  msg ("rewriting \"data\" %d times", PASS_CNT);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      random_bytes (buf, sizeof buf);
+      seek (fd, 0);
+      if (write (fd, buf, sizeof buf) != sizeof buf)
+        fail ("write pass %d failed", pass);
+    }
+  msg ("close \"data\"");
+  close (fd);
+  check_file ("data", buf, sizeof buf);
+}
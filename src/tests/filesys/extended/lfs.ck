@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "file system isn't log-structured\n"
+  if !grep (/^lfs: .*log-structured on /, @output);
+check_expected ([<<'EOF']);
+(lfs) begin
+(lfs) create "data"
+(lfs) open "data"
+(lfs) rewriting "data" 48 times
+(lfs) close "data"
+(lfs) open "data" for verification
+(lfs) verified contents of "data"
+(lfs) close "data"
+(lfs) end
+lfs: exit(0)
+EOF
+pass;
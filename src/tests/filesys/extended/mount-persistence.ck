@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({'mnt' => {'a' => [random_bytes (6000)],
+                          'sub' => {'b' => ["\0" x 512]}},
+                'keep' => []});
+pass;
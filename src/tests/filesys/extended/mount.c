@@ -0,0 +1,40 @@
+/* Creates files and a directory on the file system mounted at
+   /mnt, moves between it and the root with "..", and checks
+   that the mount point can't be removed. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[6000];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("/mnt/a", 0), "create \"/mnt/a\"");
+  CHECK ((fd = open ("/mnt/a")) > 1, "open \"/mnt/a\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"/mnt/a\"");
+  msg ("close \"/mnt/a\"");
+  close (fd);
+  check_file ("/mnt/a", buf, sizeof buf);
+
+  CHECK (mkdir ("/mnt/sub"), "mkdir \"/mnt/sub\"");
+  CHECK (chdir ("/mnt/sub"), "chdir \"/mnt/sub\"");
+  CHECK (create ("b", 512), "create \"b\"");
+  CHECK ((fd = open ("../a")) > 1, "open \"../a\"");
+  msg ("close \"../a\"");
+  close (fd);
+  CHECK (chdir ("../.."), "chdir \"../..\"");
+  CHECK (create ("keep", 0), "create \"keep\"");
+  CHECK ((fd = open ("mnt/sub/b")) > 1, "open \"mnt/sub/b\"");
+  CHECK (filesize (fd) == 512, "filesize \"mnt/sub/b\"");
+  msg ("close \"mnt/sub/b\"");
+  close (fd);
+
+  CHECK (!remove ("/mnt"), "remove \"/mnt\" (must fail)");
+}
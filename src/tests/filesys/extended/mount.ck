@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no boot phase timings\n"
+  if !grep (/^Boot phases: timer [\d.]+ ms, ide [\d.]+ ms,.* total [\d.]+ ms\.$/,
+            @output);
+check_expected ([<<'EOF']);
+(mount) begin
+(mount) create "/mnt/a"
+(mount) open "/mnt/a"
+(mount) write "/mnt/a"
+(mount) close "/mnt/a"
+(mount) open "/mnt/a" for verification
+(mount) verified contents of "/mnt/a"
+(mount) close "/mnt/a"
+(mount) mkdir "/mnt/sub"
+(mount) chdir "/mnt/sub"
+(mount) create "b"
+(mount) open "../a"
+(mount) close "../a"
+(mount) chdir "../.."
+(mount) create "keep"
+(mount) open "mnt/sub/b"
+(mount) filesize "mnt/sub/b"
+(mount) close "mnt/sub/b"
+(mount) remove "/mnt" (must fail)
+(mount) end
+mount: exit(0)
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({'ram' => {}, 'keep' => [random_bytes (6000)]});
+pass;
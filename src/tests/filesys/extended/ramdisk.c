@@ -0,0 +1,48 @@
+/* Writes files on a RAM disk mounted at /ram and a file on the
+   disk beside it.  Only the one on the disk should survive the
+   reboot, leaving /ram an empty directory. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[6000];
+
+void
+test_main (void) 
+{
+  int fd;
+  int i;
+
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("/ram/a", 0), "create \"/ram/a\"");
+  CHECK ((fd = open ("/ram/a")) > 1, "open \"/ram/a\"");
+  for (i = 0; i < 8; i++)
+    if (write (fd, buf, sizeof buf) != sizeof buf)
+      fail ("write \"/ram/a\" block %d", i);
+  msg ("close \"/ram/a\"");
+  close (fd);
+  CHECK ((fd = open ("/ram/a")) > 1, "open \"/ram/a\"");
+  CHECK (filesize (fd) == 8 * sizeof buf, "filesize \"/ram/a\"");
+  msg ("close \"/ram/a\"");
+  close (fd);
+
+  CHECK (mkdir ("/ram/sub"), "mkdir \"/ram/sub\"");
+  CHECK (create ("/ram/sub/b", 0), "create \"/ram/sub/b\"");
+  CHECK ((fd = open ("/ram/sub/b")) > 1, "open \"/ram/sub/b\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"/ram/sub/b\"");
+  msg ("close \"/ram/sub/b\"");
+  close (fd);
+  check_file ("/ram/sub/b", buf, sizeof buf);
+
+  CHECK (create ("keep", sizeof buf), "create \"keep\"");
+  CHECK ((fd = open ("keep")) > 1, "open \"keep\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"keep\"");
+  msg ("close \"keep\"");
+  close (fd);
+
+  CHECK (remove ("/ram/a"), "remove \"/ram/a\"");
+  CHECK (!remove ("/ram"), "remove \"/ram\" (must fail)");
+}
@@ -0,0 +1,34 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no RAM disk registered\n"
+  if !grep (/^ram0: .*, RAM disk$/, @output);
+check_expected ([<<'EOF']);
+(ramdisk) begin
+(ramdisk) create "/ram/a"
+(ramdisk) open "/ram/a"
+(ramdisk) close "/ram/a"
+(ramdisk) open "/ram/a"
+(ramdisk) filesize "/ram/a"
+(ramdisk) close "/ram/a"
+(ramdisk) mkdir "/ram/sub"
+(ramdisk) create "/ram/sub/b"
+(ramdisk) open "/ram/sub/b"
+(ramdisk) write "/ram/sub/b"
+(ramdisk) close "/ram/sub/b"
+(ramdisk) open "/ram/sub/b" for verification
+(ramdisk) verified contents of "/ram/sub/b"
+(ramdisk) close "/ram/sub/b"
+(ramdisk) create "keep"
+(ramdisk) open "keep"
+(ramdisk) write "keep"
+(ramdisk) close "keep"
+(ramdisk) remove "/ram/a"
+(ramdisk) remove "/ram" (must fail)
+(ramdisk) end
+ramdisk: exit(0)
+EOF
+pass;
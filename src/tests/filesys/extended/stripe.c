@@ -0,0 +1,22 @@
+/* Runs on a file system striped across two disks in 4 kB
+   chunks.  Writes a file in pieces that straddle chunk
+   boundaries, so that transfers are split between the disks,
+   and reads it back. */
+
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[102400];
+
+static size_t
+return_block_size (void) 
+{
+  return 6000;
+}
+
+void
+test_main (void) 
+{
+  seq_test ("data", buf, sizeof buf, 0, return_block_size, NULL);
+}
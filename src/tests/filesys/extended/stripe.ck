@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "file system isn't on the striped device\n"
+  if !grep (/^filesys: using md0$/, @output);
+check_expected ([<<'EOF']);
+(stripe) begin
+(stripe) create "data"
+(stripe) open "data"
+(stripe) writing "data"
+(stripe) close "data"
+(stripe) open "data" for verification
+(stripe) verified contents of "data"
+(stripe) close "data"
+(stripe) end
+stripe: exit(0)
+EOF
+pass;
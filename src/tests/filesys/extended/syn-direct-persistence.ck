@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::arc4;
+my ($fs) = {"child-syn-direct" => "tests/filesys/extended/child-syn-direct"};
+foreach my $i (0...3) {
+    my (@arc4) = arc4_init (pack ("V", $i + 1));
+    $fs->{"data$i"} = [arc4_crypt (\@arc4, "\0" x 32768)];
+}
+check_archive ($fs);
+pass;
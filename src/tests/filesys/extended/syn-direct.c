@@ -0,0 +1,37 @@
+/* Writes a file for each of several subprocesses, which read
+   and rewrite them at the same time with direct I/O, so that
+   the disk has requests from all of them queued at once. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-direct.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char file_name[16];
+  int fd;
+  size_t i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "data%zu", i);
+      random_init (i + 1);
+      random_bytes (buf, sizeof buf);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+             "write \"%s\"", file_name);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+
+  exec_children ("child-syn-direct", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,47 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($fs) = map (/^(\S+) \(filesys\): \d+ reads, \d+ writes$/, @output);
+fail "no statistics for the file system device\n" if !defined $fs;
+fail "no requests reached $fs\n"
+  if !grep (/^\Q$fs\E: [1-9]\d* bytes read, [1-9]\d* bytes written in [1-9]/,
+            @output);
+foreach my $kind ('read', 'write') {
+    fail "no $kind latencies for $fs\n"
+      if !grep (/^\Q$fs\E: $kind latency \(us\):( <\d+:\d+)+( more:\d+)?$/,
+                @output);
+}
+fail "no queue depth for the disk under $fs\n"
+  if !grep (/^\S+: queue depth \d+ max, \d+\.\d\d average$/, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-direct) begin
+(syn-direct) create "data0"
+(syn-direct) open "data0"
+(syn-direct) write "data0"
+(syn-direct) close "data0"
+(syn-direct) create "data1"
+(syn-direct) open "data1"
+(syn-direct) write "data1"
+(syn-direct) close "data1"
+(syn-direct) create "data2"
+(syn-direct) open "data2"
+(syn-direct) write "data2"
+(syn-direct) close "data2"
+(syn-direct) create "data3"
+(syn-direct) open "data3"
+(syn-direct) write "data3"
+(syn-direct) close "data3"
+(syn-direct) exec child 1 of 4: "child-syn-direct 0"
+(syn-direct) exec child 2 of 4: "child-syn-direct 1"
+(syn-direct) exec child 3 of 4: "child-syn-direct 2"
+(syn-direct) exec child 4 of 4: "child-syn-direct 3"
+(syn-direct) wait for child 1 of 4 returned 0 (expected 0)
+(syn-direct) wait for child 2 of 4 returned 1 (expected 1)
+(syn-direct) wait for child 3 of 4 returned 2 (expected 2)
+(syn-direct) wait for child 4 of 4 returned 3 (expected 3)
+(syn-direct) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_DIRECT_H
+#define TESTS_FILESYS_EXTENDED_SYN_DIRECT_H
+
+#define CHILD_CNT 4
+#define CHUNK_SIZE 4096
+#define CHUNK_CNT 8
+#define FILE_SIZE (CHUNK_SIZE * CHUNK_CNT)
+
+#endif /* tests/filesys/extended/syn-direct.h */
@@ -0,0 +1,43 @@
+/* Creates files and a directory in the tmpfs mounted at /tmp,
+   moves in and out of it with "..", and checks that a file
+   created on the disk beside it is unaffected. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[6000];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("/tmp/scratch", 0), "create \"/tmp/scratch\"");
+  CHECK ((fd = open ("/tmp/scratch")) > 1, "open \"/tmp/scratch\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"/tmp/scratch\"");
+  msg ("close \"/tmp/scratch\"");
+  close (fd);
+  check_file ("/tmp/scratch", buf, sizeof buf);
+
+  CHECK (mkdir ("/tmp/sub"), "mkdir \"/tmp/sub\"");
+  CHECK (chdir ("/tmp/sub"), "chdir \"/tmp/sub\"");
+  CHECK ((fd = open ("../scratch")) > 1, "open \"../scratch\"");
+  msg ("close \"../scratch\"");
+  close (fd);
+  CHECK (chdir ("../.."), "chdir \"../..\"");
+  CHECK (create ("keep", sizeof buf), "create \"keep\"");
+  CHECK ((fd = open ("keep")) > 1, "open \"keep\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"keep\"");
+  msg ("close \"keep\"");
+  close (fd);
+
+  CHECK (remove ("/tmp/sub"), "remove \"/tmp/sub\"");
+  CHECK (remove ("/tmp/scratch"), "remove \"/tmp/scratch\"");
+  CHECK (open ("/tmp/scratch") == -1, "open \"/tmp/scratch\" (must fail)");
+  CHECK (!remove ("/tmp"), "remove \"/tmp\" (must fail)");
+}
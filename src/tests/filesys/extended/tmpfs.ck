@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(tmpfs) begin
+(tmpfs) create "/tmp/scratch"
+(tmpfs) open "/tmp/scratch"
+(tmpfs) write "/tmp/scratch"
+(tmpfs) close "/tmp/scratch"
+(tmpfs) open "/tmp/scratch" for verification
+(tmpfs) verified contents of "/tmp/scratch"
+(tmpfs) close "/tmp/scratch"
+(tmpfs) mkdir "/tmp/sub"
+(tmpfs) chdir "/tmp/sub"
+(tmpfs) open "../scratch"
+(tmpfs) close "../scratch"
+(tmpfs) chdir "../.."
+(tmpfs) create "keep"
+(tmpfs) open "keep"
+(tmpfs) write "keep"
+(tmpfs) close "keep"
+(tmpfs) remove "/tmp/sub"
+(tmpfs) remove "/tmp/scratch"
+(tmpfs) open "/tmp/scratch" (must fail)
+(tmpfs) remove "/tmp" (must fail)
+(tmpfs) end
+tmpfs: exit(0)
+EOF
+pass;
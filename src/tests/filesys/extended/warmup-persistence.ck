@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "cache wasn't warmed up at boot\n"
+  if !grep (/^cache: warming up [1-9]\d* clusters$/, @output);
+check_archive ({'hot' => [random_bytes (8192)],
+                'cold' => [random_bytes (65536)]});
+pass;
@@ -0,0 +1,46 @@
+/* Reads a small file over and over, so that its sectors are the
+   hottest in the cache at shutdown, and writes a larger one
+   once.  The next boot warms the cache up with the small file
+   while reading both back. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOT_SIZE 8192
+#define COLD_SIZE 65536
+#define READ_CNT 20
+
+static char hot[HOT_SIZE];
+static char cold[COLD_SIZE];
+
+/* Creates FILE_NAME with the SIZE bytes in BUF. */
+static void
+write_file (const char *file_name, const char *buf, size_t size) 
+{
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, size) == (int) size, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  int i;
+
+  random_bytes (hot, sizeof hot);
+  random_bytes (cold, sizeof cold);
+  write_file ("hot", hot, sizeof hot);
+  write_file ("cold", cold, sizeof cold);
+
+  msg ("reading \"hot\" %d times", READ_CNT);
+  quiet = true;
+  for (i = 0; i < READ_CNT; i++)
+    check_file ("hot", hot, sizeof hot);
+  quiet = false;
+}
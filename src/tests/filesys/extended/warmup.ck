@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(warmup) begin
+(warmup) create "hot"
+(warmup) open "hot"
+(warmup) write "hot"
+(warmup) close "hot"
+(warmup) create "cold"
+(warmup) open "cold"
+(warmup) write "cold"
+(warmup) close "cold"
+(warmup) reading "hot" 20 times
+(warmup) end
+warmup: exit(0)
+EOF
+pass;
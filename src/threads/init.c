@@ -34,6 +34,9 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iotrace.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -49,6 +52,15 @@ static bool format_filesys;
    overriding the defaults. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
+
+/* -stripe: Member devices and chunk size of a striped device. */
+static char *stripe_spec;
+
+/* -ramdisk: Size of the RAM disk in kB, or 0 for none. */
+static size_t ramdisk_kb;
+
+/* -iotrace: Number of I/O requests to keep a trace of. */
+static size_t iotrace_entries;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
@@ -57,6 +69,15 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* Boot phases timed so far, with their lengths in microseconds,
+   and when the current phase started.  The clock only runs once
+   interrupts are on, so timing starts there. */
+#define BOOT_PHASE_MAX 8
+static const char *boot_phase_names[BOOT_PHASE_MAX];
+static int64_t boot_phase_usecs[BOOT_PHASE_MAX];
+static size_t boot_phase_cnt;
+static int64_t boot_phase_start;
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -65,6 +86,9 @@ static char **parse_options (char **argv);
 static void run_actions (char **argv);
 static void usage (void);
 
+static void boot_phase (const char *name);
+static void print_boot_phases (void);
+
 #ifdef FILESYS
 static void locate_block_devices (void);
 static void locate_block_device (enum block_type, const char *name);
@@ -117,16 +141,30 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  boot_phase_start = timer_usecs ();
   serial_init_queue ();
   timer_calibrate ();
+  boot_phase ("timer");
 
 #ifdef FILESYS
   /* Initialize file system. */
+  iotrace_init (iotrace_entries);
   ide_init ();
+  boot_phase ("ide");
+  ramdisk_init (ramdisk_kb);
+  if (stripe_spec != NULL)
+    {
+      struct block *stripe = stripe_create (stripe_spec);
+      if (filesys_bdev_name == NULL)
+        filesys_bdev_name = block_name (stripe);
+    }
   locate_block_devices ();
+  boot_phase ("block devices");
   filesys_init (format_filesys);
+  boot_phase ("file system");
 #endif
 
+  print_boot_phases ();
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -243,10 +281,26 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-lfs"))
+        filesys_lfs = true;
+      else if (!strcmp (name, "-blocksize"))
+        filesys_block_size = atoi (value);
+      else if (!strcmp (name, "-tmpfs"))
+        filesys_tmpfs = value;
+      else if (!strcmp (name, "-mount"))
+        filesys_add_mount (value);
       else if (!strcmp (name, "-filesys"))
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_spec = value;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-iotrace"))
+        iotrace_entries = atoi (value);
+      else if (!strcmp (name, "-bigdisk"))
+        ide_allow_large = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -277,6 +331,40 @@ parse_options (char **argv)
   return argv;
 }
 
+/* Ends the current boot phase, which is called NAME, and starts
+   the next. */
+static void
+boot_phase (const char *name) 
+{
+  int64_t now = timer_usecs ();
+
+  if (boot_phase_cnt < BOOT_PHASE_MAX)
+    {
+      boot_phase_names[boot_phase_cnt] = name;
+      boot_phase_usecs[boot_phase_cnt] = now - boot_phase_start;
+      boot_phase_cnt++;
+    }
+  boot_phase_start = now;
+}
+
+/* Prints how long each boot phase took, so that a slow boot can
+   be traced to its cause. */
+static void
+print_boot_phases (void) 
+{
+  int64_t total = 0;
+  size_t i;
+
+  printf ("Boot phases:");
+  for (i = 0; i < boot_phase_cnt; i++)
+    {
+      printf (" %s %"PRId64".%03"PRId64" ms,", boot_phase_names[i],
+              boot_phase_usecs[i] / 1000, boot_phase_usecs[i] % 1000);
+      total += boot_phase_usecs[i];
+    }
+  printf (" total %"PRId64".%03"PRId64" ms.\n", total / 1000, total % 1000);
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -315,6 +403,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"defrag", 2, fsutil_defrag},
 #endif
       {NULL, 0, NULL},
     };
@@ -364,6 +453,7 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+          "  defrag FILE        Make FILE's data contiguous on disk.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -371,8 +461,17 @@ usage (void)
           "  -r                 Reboot after actions.\n"
 #ifdef FILESYS
           "  -f                 Format file system device during startup.\n"
+          "  -lfs               Format it log-structured (with -f).\n"
+          "  -blocksize=BYTES   Format with BYTES per cluster (with -f).\n"
+          "  -tmpfs=PATH        Mount a memory-only file system at PATH.\n"
+          "  -mount=BDEV:PATH   Mount the file system on BDEV at PATH.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -stripe=BDEV,BDEV...[:BYTES]\n"
+          "                     Stripe file system across BDEVs in BYTES chunks.\n"
+          "  -ramdisk=KB        Create a KB kilobyte RAM disk named ram0.\n"
+          "  -bigdisk           Use IDE disks of 1 GB or more.\n"
+          "  -iotrace=N         Trace the last N I/O requests to scratch.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
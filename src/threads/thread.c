@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <filesys/file.h>
+#include "devices/block.h"
+#include "devices/iotrace.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -521,6 +523,9 @@ init_thread (struct thread *t, const char *name, int priority)
 
   if(t == initial_thread) t->parent = NULL;
   else t->parent = thread_current();
+  // a new thread does I/O in its creator's class
+  t->ioprio = t->parent != NULL ? t->parent->ioprio : BLOCK_IOPRIO_BE;
+  t->trace_inode = IOTRACE_NO_INODE;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
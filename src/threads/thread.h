@@ -121,6 +121,9 @@ struct thread
     struct file * executable; // the thread executable file 
     int max_fd; // the file descriptor used by the thread
     struct dir *cwd; // current working directory
+    int journal_depth; // nesting of open journal handles
+    int ioprio; // I/O class of block requests, an enum block_ioprio
+    uint32_t trace_inode; // inode that I/O is traced against
   };
 
 
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <devices/block.h>
 #include <devices/timer.h>
 #include <threads/malloc.h>
 #include "userprog/gdt.h"
@@ -78,7 +79,11 @@ start_process (void *file_name_)
   // token out the argument
   char *token, *save_ptr;
   token = strtok_r (file_name, " ", &save_ptr);
+  // loading the executable stalls the new process, so it goes ahead
+  // of other I/O, as a page-in would
+  enum block_ioprio ioprio = block_set_ioprio (BLOCK_IOPRIO_RT);
   success = load (token, &if_.eip, &if_.esp);
+  block_set_ioprio (ioprio);
   // put the argument in the stack as the decreasing address order
   int argc = 0;
   int argv[128];
@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <stdint.h>
 #include <syscall-nr.h>
 #include <devices/shutdown.h>
 #include <threads/vaddr.h>
@@ -16,6 +17,8 @@
 #include "syscall.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "devices/block.h"
 
 // syscall array
 syscall_function syscalls[SYSCALL_NUMBER];
@@ -55,6 +58,17 @@ void syscall_init(void)
   syscalls[SYS_READDIR] = sys_readdir;
   syscalls[SYS_ISDIR] = sys_isdir;
   syscalls[SYS_INUMBER] = sys_inumber;
+  syscalls[SYS_READDIRPLUS] = sys_readdirplus;
+  syscalls[SYS_OPENAT] = sys_openat;
+  syscalls[SYS_CREATEAT] = sys_createat;
+  syscalls[SYS_MKDIRAT] = sys_mkdirat;
+  syscalls[SYS_UNLINKAT] = sys_unlinkat;
+  syscalls[SYS_FSYNC] = sys_fsync;
+  syscalls[SYS_DIRECTIO] = sys_directio;
+  syscalls[SYS_DEFRAG] = sys_defrag;
+  syscalls[SYS_ADVISE] = sys_advise;
+  syscalls[SYS_FALLOCATE] = sys_fallocate;
+  syscalls[SYS_IOPRIO] = sys_ioprio;
 }
 
 // check whether page p and p+3 has been in kernel virtual memory
@@ -86,6 +100,18 @@ void check(void *p)
   check_page(p);
 }
 
+// make check for every page of a user buffer of size bytes
+void check_buffer(void *p, unsigned size)
+{
+  check(p);
+  if (size == 0)
+    return;
+  for (void *page = pg_round_down(p) + PGSIZE; page < p + size; page += PGSIZE)
+    check(page);
+  if (size > 4)
+    check(p + size - 4);
+}
+
 // make check for every function arguments
 void check_func_args(void *p, int argc)
 {
@@ -161,9 +187,7 @@ void sys_create(struct intr_frame *f)
   check_func_args((void *)(p + 1), 2);
   check((void *)*(p + 1));
 
-  acquire_file_lock();
   f->eax = filesys_create((const char *)*(p + 1),*(p + 2), false);
-  release_file_lock();
 }
 
 void sys_remove(struct intr_frame *f)
@@ -172,45 +196,52 @@ void sys_remove(struct intr_frame *f)
   check_func_args((void *)(p + 1), 1);
   check((void *)*(p + 1));
 
-  acquire_file_lock();
   f->eax = filesys_remove((const char *)*(p + 1));
-  release_file_lock();
 }
 
-void sys_open(struct intr_frame *f)
+// give an opened file a descriptor in the current thread
+// and return it, or -1 if open_f is null
+static int install_file(struct file *open_f)
 {
-  int *p = f->esp;
-  check_func_args((void *)(p + 1), 1);
-  check((void *)*(p + 1));
-  
-
   struct thread *t = thread_current();
-  acquire_file_lock();
-  struct file *open_f = filesys_open((const char *)*(p + 1));
-  
+
   // check whether the open file is valid
-  if (open_f)
-  {
-    struct file_node *fn = malloc(sizeof(struct file_node));
-    fn->fd = t->max_fd++;
-    fn->file = open_f;
+  if (open_f == NULL)
+    return -1;
 
-    /* Our implementation: deal with directory open */
-    struct inode *inode = file_get_inode(fn->file);
-    if (inode != NULL && inode->data.is_dir)
-    {
-      fn->dir = dir_open(inode_reopen(inode));
-    }
-    else
-      fn->dir = NULL;
+  struct file_node *fn = malloc(sizeof(struct file_node));
+  fn->fd = t->max_fd++;
+  fn->file = open_f;
 
-    // put in file list of the corresponding thread
-    list_push_back(&t->files, &fn->file_elem);
-    f->eax = fn->fd;
+  /* Our implementation: deal with directory open */
+  struct inode *inode = file_get_inode(fn->file);
+  if (inode != NULL && inode->data.is_dir)
+  {
+    fn->dir = dir_open(inode_reopen(inode));
   }
   else
-    f->eax = -1;
-  release_file_lock();
+    fn->dir = NULL;
+
+  // put in file list of the corresponding thread
+  list_push_back(&t->files, &fn->file_elem);
+  return fn->fd;
+}
+
+// return the directory opened as dirfd, or NULL if dirfd
+// is not an open directory
+static struct dir *find_dir(int dirfd)
+{
+  struct file_node *fn = find_file(&thread_current()->files, dirfd, false, true);
+  return fn != NULL ? fn->dir : NULL;
+}
+
+void sys_open(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+  check((void *)*(p + 1));
+
+  f->eax = install_file(filesys_open((const char *)*(p + 1)));
 }
 
 void sys_filesize(struct intr_frame *f)
@@ -342,10 +373,8 @@ void sys_chdir(struct intr_frame *f)
   check_func_args((void *)(p + 1), 1);
   check((void *)*(p + 1));
 
-  acquire_file_lock();
   // change the current directory
   f->eax = filesys_chdir((const char *)*(p + 1)); 
-  release_file_lock();
 }
 
 void sys_mkdir(struct intr_frame *f)
@@ -354,10 +383,8 @@ void sys_mkdir(struct intr_frame *f)
   check_func_args((void *)(p + 1), 1);
   check((void *)*(p + 1));
 
-  acquire_file_lock();
   // create a new directory
   f->eax = filesys_create((const char *)*(p + 1), 0, true); 
-  release_file_lock();
 }
 
 void sys_readdir(struct intr_frame *f)
@@ -383,6 +410,166 @@ void sys_readdir(struct intr_frame *f)
     release_file_lock();
 }
 
+void sys_readdirplus(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 3);
+
+  struct dir_entry_info *entries = (struct dir_entry_info *)*(p + 2);
+  unsigned cnt = *(p + 3);
+  if (cnt > PGSIZE)
+    cnt = PGSIZE;
+  check_buffer((void *)entries, cnt * sizeof *entries);
+
+  acquire_file_lock();
+  // fill as many entries as fit in one call
+  struct file_node *file_d = find_file(&thread_current()->files, *(p + 1), false, true);
+  if (file_d != NULL)
+  {
+    unsigned i = 0;
+    while (i < cnt && dir_readdir_plus(file_d->dir, &entries[i]))
+      i++;
+    f->eax = i;
+  }
+  else
+    f->eax = -1;
+  release_file_lock();
+}
+
+void sys_openat(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  check((void *)*(p + 2));
+
+  struct dir *dir = find_dir(*(p + 1));
+  // resolve the name relative to the directory fd
+  f->eax = dir != NULL ? install_file(filesys_open_at(dir, (const char *)*(p + 2))) : -1;
+}
+
+void sys_createat(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 3);
+  check((void *)*(p + 2));
+
+  struct dir *dir = find_dir(*(p + 1));
+  f->eax = dir != NULL && filesys_create_at(dir, (const char *)*(p + 2), *(p + 3), false);
+}
+
+void sys_mkdirat(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  check((void *)*(p + 2));
+
+  struct dir *dir = find_dir(*(p + 1));
+  f->eax = dir != NULL && filesys_create_at(dir, (const char *)*(p + 2), 0, true);
+}
+
+void sys_unlinkat(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  check((void *)*(p + 2));
+
+  struct dir *dir = find_dir(*(p + 1));
+  f->eax = dir != NULL && filesys_remove_at(dir, (const char *)*(p + 2));
+}
+
+void sys_fsync(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+
+  // no file_lock: the commit waits for writers that may hold it
+  struct file_node *open_f = find_file(&thread_current()->files, *(p + 1), true, true);
+  if (open_f != NULL)
+  {
+    // the file's data first, then the metadata that points at it
+    inode_sync(open_f->file != NULL ? file_get_inode(open_f->file)
+                                    : dir_get_inode(open_f->dir));
+    journal_commit();
+  }
+  f->eax = open_f != NULL;
+}
+
+void sys_directio(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+
+  // directories are metadata and always go through the cache
+  struct file_node *open_f = find_file(&thread_current()->files, *(p + 1), true, false);
+  if (open_f != NULL)
+  {
+    acquire_file_lock();
+    file_set_direct(open_f->file, *(p + 2) != 0);
+    release_file_lock();
+  }
+  f->eax = open_f != NULL;
+}
+
+void sys_defrag(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+
+  struct defrag_stats *stats = (struct defrag_stats *)*(p + 2);
+  check_buffer((void *)stats, sizeof *stats);
+
+  acquire_file_lock();
+  struct file_node *open_f = find_file(&thread_current()->files, *(p + 1), true, false);
+  release_file_lock();
+  // inode_defrag() takes file_lock itself, but not while copying
+  f->eax = open_f != NULL && inode_defrag(file_get_inode(open_f->file), stats);
+}
+
+void sys_advise(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 4);
+
+  acquire_file_lock();
+  struct file_node *open_f = find_file(&thread_current()->files, *(p + 1), true, false);
+  f->eax = open_f != NULL && file_advise(open_f->file, *(p + 2), *(p + 3), *(p + 4));
+  release_file_lock();
+}
+
+void sys_fallocate(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 3);
+
+  // the byte range must fit in an off_t
+  unsigned offset = *(p + 2), length = *(p + 3);
+  if (offset > INT32_MAX || length > INT32_MAX - offset)
+  {
+    f->eax = false;
+    return;
+  }
+
+  acquire_file_lock();
+  struct file_node *open_f = find_file(&thread_current()->files, *(p + 1), true, false);
+  f->eax = open_f != NULL && inode_fallocate(file_get_inode(open_f->file), offset + length);
+  release_file_lock();
+}
+
+void sys_ioprio(struct intr_frame *f)
+{
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+
+  // -1 only asks for the current class
+  int ioclass = *(p + 1);
+  if (ioclass == -1)
+    f->eax = thread_current()->ioprio;
+  else if (ioclass >= 0 && ioclass < BLOCK_IOPRIO_CNT)
+    f->eax = block_set_ioprio(ioclass);
+  else
+    f->eax = -1;
+}
+
 void sys_isdir(struct intr_frame *f)
 {
   int *p = f->esp;
@@ -5,7 +5,7 @@
 #include "list.h"
 
 typedef void (*syscall_function) (struct intr_frame *);
-#define SYSCALL_NUMBER 20
+#define SYSCALL_NUMBER 31
 
 // the struct of opened file
 struct file_node {
@@ -22,6 +22,7 @@ void check(void *);
 void check_func_args(void *, int);
 void check_page(void *);
 void check_addr(void *p);
+void check_buffer(void *, unsigned);
 
 // declarations of syscalls
 void sys_exit(struct intr_frame *);
@@ -43,6 +44,17 @@ void sys_mkdir(struct intr_frame * f);
 void sys_readdir(struct intr_frame * f);
 void sys_isdir(struct intr_frame * f);
 void sys_inumber(struct intr_frame * f);
+void sys_readdirplus(struct intr_frame * f);
+void sys_openat(struct intr_frame * f);
+void sys_createat(struct intr_frame * f);
+void sys_mkdirat(struct intr_frame * f);
+void sys_unlinkat(struct intr_frame * f);
+void sys_fsync(struct intr_frame * f);
+void sys_directio(struct intr_frame * f);
+void sys_defrag(struct intr_frame * f);
+void sys_advise(struct intr_frame * f);
+void sys_fallocate(struct intr_frame * f);
+void sys_ioprio(struct intr_frame * f);
 
 struct file_node *find_file(struct list *files, int fd, bool search_file, bool search_folder);
 
@@ -0,0 +1,653 @@
+/* cachesim: replays an I/O trace saved by the Pintos kernel's
+   -iotrace option against simulated caches of several sizes,
+   each managed by CLOCK, 2Q, and ARC, and reports their hit
+   rates.
+
+   The kernel writes the trace to the end of its scratch device.
+   Rather than having to know where that is, cachesim scans its
+   input for the last trace header on a sector boundary, so it
+   may be given a whole disk image as well as a trace cut out of
+   one. */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Trace format.  Must agree with src/devices/iotrace.h. */
+#define SECTOR_SIZE 512
+#define IOTRACE_MAGIC "IOTRACE1"
+#define IOTRACE_MAX_DEVS 16
+#define IOTRACE_CACHE_DEV 0xff
+#define IOTRACE_MISS 0x01
+
+enum iotrace_op
+  {
+    IOTRACE_CACHE_READ,
+    IOTRACE_CACHE_WRITE,
+    IOTRACE_BLOCK_READ,
+    IOTRACE_BLOCK_WRITE
+  };
+
+struct iotrace_header
+  {
+    char magic[8];
+    uint32_t entry_cnt;
+    uint32_t lost_cnt;
+    uint32_t dev_cnt;
+    char devs[IOTRACE_MAX_DEVS][16];
+  };
+
+struct iotrace_entry
+  {
+    int64_t usecs;
+    uint32_t sector;
+    uint32_t cnt;
+    uint32_t inode;
+    int32_t tid;
+    uint8_t op;
+    uint8_t dev;
+    uint8_t flags;
+    uint8_t reserved[5];
+  };
+
+/* Cache sizes, in entries, to simulate by default. */
+static const size_t default_sizes[] = { 16, 32, 64, 128, 256, 512, 1024 };
+#define MAX_SIZES 32
+
+/* Replacement policies. */
+enum policy
+  {
+    POLICY_CLOCK,               /* Second chance. */
+    POLICY_2Q,                  /* Johnson and Shasha's full 2Q. */
+    POLICY_ARC,                 /* Megiddo and Modha's ARC. */
+    POLICY_CNT
+  };
+
+static const char *policy_names[POLICY_CNT] = { "clock", "2q", "arc" };
+
+/* The lists a block can be on.  CLOCK uses only the first, as
+   its ring; 2Q uses the first three; ARC uses all four.  Ghost
+   lists remember recently evicted blocks without holding
+   them. */
+enum
+  {
+    T1 = 0, A1IN = 0, RING = 0, /* Resident, seen once lately. */
+    B1 = 1, A1OUT = 1,          /* Ghosts of T1 / A1in. */
+    T2 = 2, AM = 2,             /* Resident, seen more than once. */
+    B2 = 3,                     /* Ghosts of T2. */
+    LIST_CNT = 4
+  };
+
+/* A block, resident or ghost. */
+struct node
+  {
+    uint64_t key;               /* Block number. */
+    int list;                   /* List it is on. */
+    bool ref;                   /* CLOCK: referenced since the hand
+                                   last passed? */
+    struct node *prev, *next;   /* Neighbors on its list. */
+    struct node *chain;         /* Next in hash bucket. */
+  };
+
+/* A list of nodes, most recently used (or inserted) first. */
+struct list
+  {
+    struct node *head, *tail;
+    size_t cnt;
+  };
+
+/* A simulated cache. */
+struct sim
+  {
+    enum policy policy;
+    size_t cap;                 /* Resident blocks at most. */
+    size_t p;                   /* ARC: target size of T1. */
+    struct list lists[LIST_CNT];
+    struct node **buckets;      /* Hash table of all nodes. */
+    size_t bucket_mask;         /* Number of buckets, minus 1. */
+    struct node *nodes;         /* Every node. */
+    struct node *free_nodes;    /* Unused nodes. */
+    uint64_t accesses;          /* Blocks accessed. */
+    uint64_t hits;              /* Accesses found resident. */
+  };
+
+static void *
+xcalloc (size_t n, size_t size)
+{
+  void *p = calloc (n, size);
+  if (p == NULL)
+    {
+      fprintf (stderr, "cachesim: out of memory\n");
+      exit (EXIT_FAILURE);
+    }
+  return p;
+}
+
+/* Returns the hash bucket for KEY in S. */
+static struct node **
+bucket (struct sim *s, uint64_t key)
+{
+  return &s->buckets[(key * 0x9e3779b97f4a7c15ULL >> 32) & s->bucket_mask];
+}
+
+/* Returns the node for KEY in S, or a null pointer if S has
+   none. */
+static struct node *
+lookup (struct sim *s, uint64_t key)
+{
+  struct node *n;
+
+  for (n = *bucket (s, key); n != NULL; n = n->chain)
+    if (n->key == key)
+      return n;
+  return NULL;
+}
+
+/* Takes N off its list. */
+static void
+unlink_node (struct sim *s, struct node *n)
+{
+  struct list *l = &s->lists[n->list];
+
+  if (n->prev != NULL)
+    n->prev->next = n->next;
+  else
+    l->head = n->next;
+  if (n->next != NULL)
+    n->next->prev = n->prev;
+  else
+    l->tail = n->prev;
+  l->cnt--;
+}
+
+/* Puts N at the front of list LIST. */
+static void
+push_front (struct sim *s, struct node *n, int list)
+{
+  struct list *l = &s->lists[list];
+
+  n->list = list;
+  n->prev = NULL;
+  n->next = l->head;
+  if (l->head != NULL)
+    l->head->prev = n;
+  else
+    l->tail = n;
+  l->head = n;
+  l->cnt++;
+}
+
+/* Moves N to the front of list LIST. */
+static void
+move_front (struct sim *s, struct node *n, int list)
+{
+  unlink_node (s, n);
+  push_front (s, n, list);
+}
+
+/* Adds a node for KEY to the front of list LIST and returns
+   it. */
+static struct node *
+add (struct sim *s, uint64_t key, int list)
+{
+  struct node *n = s->free_nodes;
+  struct node **b = bucket (s, key);
+
+  s->free_nodes = n->chain;
+  n->key = key;
+  n->ref = false;
+  n->chain = *b;
+  *b = n;
+  push_front (s, n, list);
+  return n;
+}
+
+/* Forgets the block at the end of list LIST, which must not be
+   empty. */
+static void
+drop_last (struct sim *s, int list)
+{
+  struct node *n = s->lists[list].tail;
+  struct node **b;
+
+  unlink_node (s, n);
+  for (b = bucket (s, n->key); *b != n; b = &(*b)->chain)
+    continue;
+  *b = n->chain;
+  n->chain = s->free_nodes;
+  s->free_nodes = n;
+}
+
+/* Moves the block at the end of list FROM to the front of list
+   TO, which must be a ghost list, keeping at most MAX ghosts
+   there. */
+static void
+demote_last (struct sim *s, int from, int to, size_t max)
+{
+  move_front (s, s->lists[from].tail, to);
+  while (s->lists[to].cnt > max)
+    drop_last (s, to);
+}
+
+/* Accesses KEY in S under CLOCK.  Returns true if it was
+   resident. */
+static bool
+clock_access (struct sim *s, uint64_t key)
+{
+  struct node *n = lookup (s, key);
+
+  if (n != NULL)
+    {
+      n->ref = true;
+      return true;
+    }
+
+  /* The tail of the ring is under the hand.  Give referenced
+     blocks a second chance until one isn't. */
+  if (s->lists[RING].cnt == s->cap)
+    {
+      while (s->lists[RING].tail->ref)
+        {
+          s->lists[RING].tail->ref = false;
+          move_front (s, s->lists[RING].tail, RING);
+        }
+      drop_last (s, RING);
+    }
+  add (s, key, RING)->ref = true;
+  return false;
+}
+
+/* Accesses KEY in S under 2Q.  Returns true if it was
+   resident. */
+static bool
+twoq_access (struct sim *s, uint64_t key)
+{
+  size_t kin = s->cap / 4 > 0 ? s->cap / 4 : 1;
+  size_t kout = s->cap / 2 > 0 ? s->cap / 2 : 1;
+  struct node *n = lookup (s, key);
+
+  if (n != NULL && n->list == AM)
+    {
+      move_front (s, n, AM);
+      return true;
+    }
+  if (n != NULL && n->list == A1IN)
+    return true;
+
+  /* A block remembered in A1out has been seen twice.  Take it
+     off A1out first so that making room can't forget it. */
+  if (n != NULL)
+    unlink_node (s, n);
+
+  /* Make room, from A1in while it is over its share. */
+  if (s->lists[A1IN].cnt + s->lists[AM].cnt >= s->cap)
+    {
+      if (s->lists[A1IN].cnt > kin || s->lists[AM].cnt == 0)
+        demote_last (s, A1IN, A1OUT, kout);
+      else
+        drop_last (s, AM);
+    }
+
+  if (n != NULL)
+    push_front (s, n, AM);
+  else
+    add (s, key, A1IN);
+  return false;
+}
+
+/* Makes room in ARC cache S, if it is full, for a block, which
+   is in B2 if IN_B2. */
+static void
+arc_replace (struct sim *s, bool in_b2)
+{
+  size_t t1 = s->lists[T1].cnt;
+
+  if (t1 + s->lists[T2].cnt < s->cap)
+    return;
+  if (t1 > 0
+      && (t1 > s->p || (in_b2 && t1 == s->p) || s->lists[T2].cnt == 0))
+    demote_last (s, T1, B1, s->cap);
+  else
+    demote_last (s, T2, B2, s->cap);
+}
+
+/* Accesses KEY in S under ARC.  Returns true if it was
+   resident. */
+static bool
+arc_access (struct sim *s, uint64_t key)
+{
+  struct node *n = lookup (s, key);
+  size_t b1 = s->lists[B1].cnt, b2 = s->lists[B2].cnt;
+  size_t l1, total, delta;
+
+  if (n != NULL && (n->list == T1 || n->list == T2))
+    {
+      move_front (s, n, T2);
+      return true;
+    }
+
+  /* A ghost hit moves the target toward the list it came from.
+     The ghost comes off its list first so that making room
+     can't forget it. */
+  if (n != NULL)
+    {
+      bool in_b2 = n->list == B2;
+
+      if (!in_b2)
+        {
+          delta = b2 > b1 ? b2 / b1 : 1;
+          s->p = s->p + delta < s->cap ? s->p + delta : s->cap;
+        }
+      else
+        {
+          delta = b1 > b2 ? b1 / b2 : 1;
+          s->p = s->p > delta ? s->p - delta : 0;
+        }
+      unlink_node (s, n);
+      arc_replace (s, in_b2);
+      push_front (s, n, T2);
+      return false;
+    }
+
+  /* A block not seen lately. */
+  l1 = s->lists[T1].cnt + b1;
+  total = l1 + s->lists[T2].cnt + b2;
+  if (l1 == s->cap)
+    {
+      if (s->lists[T1].cnt < s->cap)
+        {
+          drop_last (s, B1);
+          arc_replace (s, false);
+        }
+      else
+        drop_last (s, T1);
+    }
+  else if (total >= s->cap)
+    {
+      if (total == 2 * s->cap)
+        drop_last (s, B2);
+      arc_replace (s, false);
+    }
+  add (s, key, T1);
+  return false;
+}
+
+/* Creates a cache of CAP blocks managed by POLICY. */
+static struct sim *
+sim_create (enum policy policy, size_t cap)
+{
+  struct sim *s = xcalloc (1, sizeof *s);
+  size_t node_cnt = 2 * cap + 1;
+  size_t bucket_cnt = 1;
+  size_t i;
+
+  while (bucket_cnt < node_cnt)
+    bucket_cnt *= 2;
+
+  s->policy = policy;
+  s->cap = cap;
+  s->buckets = xcalloc (bucket_cnt, sizeof *s->buckets);
+  s->bucket_mask = bucket_cnt - 1;
+  s->nodes = xcalloc (node_cnt, sizeof *s->nodes);
+  for (i = 0; i < node_cnt; i++)
+    {
+      s->nodes[i].chain = s->free_nodes;
+      s->free_nodes = &s->nodes[i];
+    }
+  return s;
+}
+
+/* Destroys S. */
+static void
+sim_destroy (struct sim *s)
+{
+  free (s->nodes);
+  free (s->buckets);
+  free (s);
+}
+
+/* Accesses block KEY in S. */
+static void
+sim_access (struct sim *s, uint64_t key)
+{
+  bool hit;
+
+  switch (s->policy)
+    {
+    case POLICY_CLOCK:
+      hit = clock_access (s, key);
+      break;
+    case POLICY_2Q:
+      hit = twoq_access (s, key);
+      break;
+    case POLICY_ARC:
+      hit = arc_access (s, key);
+      break;
+    default:
+      abort ();
+    }
+  s->accesses++;
+  if (hit)
+    s->hits++;
+}
+
+/* Reads the last trace in FILE_NAME into *HEADER and returns its
+   entries, or exits with an error message if there is none. */
+static struct iotrace_entry *
+read_trace (const char *file_name, struct iotrace_header *header)
+{
+  unsigned char sector[SECTOR_SIZE];
+  struct iotrace_entry *entries;
+  long found = -1, ofs;
+  size_t i;
+  FILE *f;
+
+  f = fopen (file_name, "rb");
+  if (f == NULL)
+    {
+      fprintf (stderr, "cachesim: %s: %s\n", file_name, strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+
+  for (ofs = 0; fread (sector, SECTOR_SIZE, 1, f) == 1; ofs += SECTOR_SIZE)
+    if (!memcmp (sector, IOTRACE_MAGIC, 8))
+      {
+        found = ofs;
+        memcpy (header, sector, sizeof *header);
+      }
+  if (found < 0)
+    {
+      fprintf (stderr, "cachesim: %s: no I/O trace found\n", file_name);
+      exit (EXIT_FAILURE);
+    }
+
+  entries = xcalloc (header->entry_cnt + 1, sizeof *entries);
+  if (fseek (f, found + SECTOR_SIZE, SEEK_SET) != 0
+      || fread (entries, sizeof *entries, header->entry_cnt, f)
+         != header->entry_cnt)
+    {
+      fprintf (stderr, "cachesim: %s: trace is truncated\n", file_name);
+      exit (EXIT_FAILURE);
+    }
+  fclose (f);
+
+  if (header->dev_cnt > IOTRACE_MAX_DEVS)
+    header->dev_cnt = IOTRACE_MAX_DEVS;
+  for (i = 0; i < header->dev_cnt; i++)
+    header->devs[i][sizeof header->devs[i] - 1] = '\0';
+  return entries;
+}
+
+/* Returns true if E is one of the requests to replay: cache
+   requests if BLOCK_LEVEL is false, otherwise block requests,
+   to device DEV only if it is nonnegative. */
+static bool
+replayed (const struct iotrace_entry *e, bool block_level, int dev)
+{
+  if (!block_level)
+    return e->op == IOTRACE_CACHE_READ || e->op == IOTRACE_CACHE_WRITE;
+  return ((e->op == IOTRACE_BLOCK_READ || e->op == IOTRACE_BLOCK_WRITE)
+          && (dev < 0 || e->dev == dev));
+}
+
+/* Replays the CNT ENTRIES that replayed() selects against S,
+   which caches UNIT-sector blocks. */
+static void
+replay (struct sim *s, const struct iotrace_entry *entries, size_t cnt,
+        bool block_level, int dev, uint32_t unit)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct iotrace_entry *e = &entries[i];
+      uint64_t first, last, b;
+
+      if (!replayed (e, block_level, dev))
+        continue;
+
+      /* A cache request touches one sector.  A block request
+         touches all of its sectors, and blocks on different
+         devices are different. */
+      first = e->sector / unit;
+      last = block_level && e->cnt > 0 ? (e->sector + e->cnt - 1) / unit
+                                       : first;
+      for (b = first; b <= last; b++)
+        sim_access (s, (uint64_t) e->dev << 32 | b);
+    }
+}
+
+static void
+usage (const char *program_name)
+{
+  fprintf (stderr,
+           "cachesim: replays a Pintos I/O trace against simulated caches\n"
+           "usage: %s [OPTION...] TRACE\n"
+           "  where TRACE is a file or disk image holding a trace saved\n"
+           "  with -iotrace.  Options:\n"
+           "  -s N[,N...]  Simulate caches of N entries (default:\n"
+           "               16 to 1024 in powers of 2).\n"
+           "  -u SECTORS   Sectors per cache entry (default: the kernel's\n"
+           "               for cache requests, 1 for block requests).\n"
+           "  -b           Replay block device requests instead of\n"
+           "               buffer cache requests.\n"
+           "  -d DEV       With -b, replay only requests to device DEV.\n",
+           program_name);
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *program_name = argv[0];
+  struct iotrace_header header;
+  struct iotrace_entry *entries;
+  size_t sizes[MAX_SIZES];
+  size_t size_cnt = 0;
+  bool block_level = false;
+  uint32_t unit = 0;
+  uint64_t requests = 0, kernel_misses = 0;
+  int dev = -1;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "s:u:bd:")) != -1)
+    switch (opt)
+      {
+      case 's':
+        {
+          char *p = optarg;
+          while (*p != '\0')
+            {
+              char *end;
+              long n = strtol (p, &end, 10);
+              if (end == p || n <= 0 || size_cnt == MAX_SIZES)
+                usage (program_name);
+              sizes[size_cnt++] = n;
+              p = *end == ',' ? end + 1 : end;
+            }
+        }
+        break;
+      case 'u':
+        unit = atoi (optarg);
+        if (unit == 0)
+          usage (program_name);
+        break;
+      case 'b':
+        block_level = true;
+        break;
+      case 'd':
+        dev = atoi (optarg);
+        break;
+      default:
+        usage (program_name);
+      }
+  if (optind != argc - 1)
+    usage (program_name);
+  if (size_cnt == 0)
+    {
+      size_cnt = sizeof default_sizes / sizeof *default_sizes;
+      memcpy (sizes, default_sizes, sizeof default_sizes);
+    }
+
+  entries = read_trace (argv[optind], &header);
+  printf ("Trace: %"PRIu32" requests, %"PRIu32" lost.  Devices:",
+          header.entry_cnt, header.lost_cnt);
+  for (i = 0; i < header.dev_cnt; i++)
+    printf (" %zu=%s", i, header.devs[i]);
+  printf ("\n");
+
+  /* Count what is to be replayed.  The kernel records each cache
+     request with its entry size and whether it missed. */
+  for (i = 0; i < header.entry_cnt; i++)
+    if (replayed (&entries[i], block_level, dev))
+      {
+        requests++;
+        if (!block_level)
+          {
+            if (unit == 0)
+              unit = entries[i].cnt;
+            if (entries[i].flags & IOTRACE_MISS)
+              kernel_misses++;
+          }
+      }
+  if (unit == 0)
+    unit = 1;
+  if (requests == 0)
+    {
+      printf ("No %s requests to replay.\n", block_level ? "block" : "cache");
+      return EXIT_SUCCESS;
+    }
+  printf ("Replaying %"PRIu64" %s requests in %"PRIu32"-sector entries.\n",
+          requests, block_level ? "block" : "cache", unit);
+  if (!block_level)
+    printf ("Kernel cache: %.2f%% hits.\n",
+            100.0 * (requests - kernel_misses) / requests);
+
+  printf ("%8s", "entries");
+  for (i = 0; i < POLICY_CNT; i++)
+    printf ("  %7s", policy_names[i]);
+  printf ("\n");
+  for (i = 0; i < size_cnt; i++)
+    {
+      int p;
+
+      printf ("%8zu", sizes[i]);
+      for (p = 0; p < POLICY_CNT; p++)
+        {
+          struct sim *s = sim_create (p, sizes[i]);
+          replay (s, entries, header.entry_cnt, block_level, dev, unit);
+          printf ("  %6.2f%%", 100.0 * s->hits / s->accesses);
+          sim_destroy (s);
+        }
+      printf ("\n");
+    }
+
+  free (entries);
+  return EXIT_SUCCESS;
+}